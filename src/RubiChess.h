@@ -26,6 +26,12 @@
 // Enable to get statistical values about various search features
 //#define STATISTICS
 
+// Enable to save the board per ply and restore it by copy in unplayMove instead of undoing the move
+//#define COPYMAKE
+
+// Enable to use variable shift magics (or pext) with one compact attack table for all sliders instead of fixed size tables per square
+//#define FANCYMAGICS
+
 // Enable to debug the search against a gives pv
 //#define SDEBUG
 
@@ -116,6 +122,14 @@
 #undef USE_SIMD
 #endif
 
+#ifdef DISPATCHARCH
+// Multi arch build: The engine is compiled once per arch into its own namespace rubichess_<arch>
+// and the dispatcher in cputest.cpp calls dispatchedMain of the best arch supported by the cpu
+#define DISPATCHNAMESPACE2(a) rubichess_ ## a
+#define DISPATCHNAMESPACE(a) DISPATCHNAMESPACE2(a)
+#define rubichess DISPATCHNAMESPACE(DISPATCHARCH)
+#endif
+
 using namespace std;
 
 namespace rubichess {
@@ -397,7 +411,8 @@ struct pawnhashentry;
 #define MAXHASH     0x100000  // 1TB ... never tested
 #define DEFAULTHASH 16
 #define CORRHISTSIZE 0x4000
-#define SIZEOFPH 16           // Fixed size of pawn hash in MB
+#define SIZEOFPH 16           // Fixed size of the per-thread pawn hash in MB
+#define MAXPAWNHASH 0x1000    // Maximum size of the shared pawn hash in MB
 
 #define MAXDEPTH 256
 #define MOVESTACKRESERVE 48     // to avoid checking for height reaching MAXDEPTH in probe_wds and getQuiescence
@@ -765,8 +780,11 @@ typedef void(*initevalfunc)(void);
 //
 // tests stuff
 //
-void perftest(int maxdepth);
+void perftest(int maxdepth, bool fast);
 void speedtest(int threads, int hash, int time);
+void ttspeedtest(int hash, int depth);
+void evalspeedtest(int count);
+void evalbench(string epdfilename);
 void testengine(string epdfilename, int startnum, string engineprgs, string logfilename, string comparefilename, int maxtime, int flags);
 
 
@@ -788,16 +806,20 @@ string IndexToAlgebraic(int i);
 void BitboardDraw(U64 b);
 U64 getTime();
 void bind_thread(int index);
+void numa_interleave(void* p, size_t size);
 string numa_configuration();
 string CurrentWorkingDir();
 void generateEpd(string egn);
-#ifdef _WIN32
+#if defined(_WIN32) || (defined(__linux__) && !defined(__ANDROID__))
+#define USE_LARGEPAGES
 void* my_large_malloc(size_t s);
 void my_large_free(void *m);
 #else
 #define my_large_malloc(x) allocalign64(x)
 #define my_large_free(m) freealigned64(m)
 #endif
+void* my_map_file(string filename, size_t* size);
+void my_unmap_file(void* m, size_t size);
 #ifdef STACKDEBUG
 void GetStackWalk(chessposition *pos, const char* message, const char* _File, int Line, int num, ...);
 #endif
@@ -822,9 +844,48 @@ enum NnueType { NnueDisabled = 0, NnueArchV1, NnueArchV5 };
 #define NNUEFEATUTEHASH_HalfKAv2_hm 0x7f234cb8u
 #define NNUEINPUTSLICEHASH          0xEC42E90Du
 
+// Network file in native layout ('export <file> native'): The feature transformer and the network layers are
+// stored in the in-memory layout at 64 byte aligned offsets so it can be mapped read-only and shared by all
+// engine processes. The network layers are also stored in the usual format for binaries with other SIMD kernels.
+#define NNUENATIVEMAGIC             "RubiChessNative"
+#define NNUENATIVEVERSION           2
+struct NnueNativeHeader {
+    char magic[16];
+    uint32_t nativeversion;
+    uint32_t fileversion;       // version of the network in the usual file format
+    uint32_t hash;              // feature transformer hash ^ network hash
+    uint32_t ftdims;
+    uint32_t inputdims;
+    uint32_t psqtbuckets;
+    uint32_t weightlayout;      // order of the layer weights as used by the SIMD kernels of the exporting binary
+    uint32_t reserved;
+    uint64_t biasoffset;
+    uint64_t weightoffset;
+    uint64_t psqtoffset;
+    uint64_t nativelayeroffset; // network layers in the in-memory layout
+    uint64_t nativelayersize;
+    uint64_t layeroffset;       // network layers in the usual file format
+    uint64_t layersize;
+};
+
+// Chunked compressed network file ('export <file> zchunks'): The network is split into chunks that are compressed independently
+// so they can be inflated by all threads. The header is followed by the compressed sizes and the compressed chunks.
+#define NNUEZCHUNKMAGIC             "RubiChessZChunk"
+#define NNUEZCHUNKSIZE              (1 << 22)
+struct NnueZChunkHeader {
+    char magic[16];
+    uint32_t chunks;
+    uint32_t chunksize;         // inflated size of all chunks but the last one
+    uint64_t size;              // inflated size of the network
+};
+
 #define ORIENT(c,i) ((c) ? (i) ^ 0x3f : (i))
 #define HMORIENT(c,i,k) (i ^ (bool(c) * 56) ^ ((FILE(k) < 4) * 7))
+// Slots of the accumulator cache per color: HalfKP needs one per king square, HalfKAv2_hm one per (mirrored) king bucket
+#define NNUECACHESLOTS(Nt) ((Nt) == NnueArchV1 ? 64 : 32)
 #define MULTIPLEOFN(i,n) (((i) + (n - 1)) / n * n)
+// Number of positions that GetEvalBatch propagates through the layers at once
+#define NNUEBATCHSIZE 16
 
 #if defined(USE_SSE2) && !defined(USE_SSSE3) && defined FASTSSE2
 // for native SSE2 platforms we have faster intrinsics for 16bit integers
@@ -867,20 +928,67 @@ public:
 };
 
 
+// Kernels timed by the evalbench command
+enum NnueKernel { NnueKernelRefresh, NnueKernelIncremental, NnueKernelTransform, NnueKernelHidden1, NnueKernelSqrClipped1, NnueKernelClipped1,
+    NnueKernelHidden2, NnueKernelClipped2, NnueKernelOutput, NnueKernelNum };
+
+struct NnueKernelTimer {
+    // Calls of a kernel on the same input per measurement; a single call of the small layers takes less than reading the clock
+    static constexpr int Repeat = 64;
+    U64 ns[NnueKernelNum];
+    U64 calls[NnueKernelNum];
+    U64 measurements[NnueKernelNum];
+    string name[NnueKernelNum];
+    static U64 now() {
+        return (U64)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    // account the time since start to a single call of kernel k
+    void add(NnueKernel k, U64 start) {
+        ns[k] += now() - start;
+        calls[k]++;
+        measurements[k]++;
+    }
+    // time Repeat calls of kernel k
+    template <typename F> void run(NnueKernel k, F kernel) {
+        U64 start = now();
+        for (int i = 0; i < Repeat; i++)
+        {
+            kernel();
+            // keep the compiler from merging the calls on the unchanged input
+#ifdef __GNUC__
+            __asm__ __volatile__("" ::: "memory");
+#elif defined(_MSC_VER)
+            _ReadWriteBarrier();
+#endif
+        }
+        ns[k] += now() - start;
+        calls[k] += Repeat;
+        measurements[k]++;
+    }
+};
+
+
 class NnueArchitecture
 {
 public:
+    virtual ~NnueArchitecture() {}
     virtual bool ReadFeatureWeights(NnueNetsource* nr, bool bpz) = 0;
     virtual bool ReadWeights(NnueNetsource* nr, uint32_t nethash) = 0;
+    virtual bool ReadNativeWeights(NnueNetsource* nr) = 0;
     virtual void WriteFeatureWeights(NnueNetsource* nr, bool bpz) = 0;
     virtual void WriteWeights(NnueNetsource* nr, uint32_t nethash) = 0;
+    virtual void WriteNativeWeights(NnueNetsource* nr) = 0;
+    virtual uint32_t GetWeightLayout() = 0;
     virtual void RescaleLastLayer(int ratio64) = 0;
     virtual string GetArchName() = 0;
     virtual string GetArchDescription() = 0;
     virtual uint32_t GetFtHash() = 0;
     virtual uint32_t GetHash() = 0;
     virtual int GetEval(chessposition* pos) = 0;
+    virtual void GetEvalBatch(chessposition** pos, int n, int* out) = 0;
+    virtual void BenchKernels(chessposition* pos, NnueKernelTimer* timer) = 0;
     virtual void SpeculativeEval(chessposition* pos) = 0;
+    virtual void PrefetchFeatureWeights(chessposition* pos) = 0;
     virtual int16_t* GetFeatureWeight() = 0;
     virtual int16_t* GetFeatureBias() = 0;
     virtual int32_t* GetFeaturePsqtWeight() = 0;
@@ -892,6 +1000,8 @@ public:
     virtual unsigned int GetAccumulationSize() = 0;
     virtual unsigned int GetPsqtAccumulationSize() = 0;
     virtual size_t GetNetworkFilesize() = 0;
+    virtual void GetNativeLayout(NnueNativeHeader* header) = 0;
+    virtual bool MapFeatureWeights(unsigned char* base, NnueNativeHeader* header) = 0;
 #ifdef STATISTICS
     virtual void SwapInputNeurons(unsigned int i1, unsigned int i2) = 0;
     virtual void Statistics(bool verbose, bool sort) = 0;
@@ -916,7 +1026,10 @@ public:
     NnueLayer(NnueLayer* prev) { previous = prev; }
     virtual bool ReadWeights(NnueNetsource* nr) = 0;
     virtual void WriteWeights(NnueNetsource* nr) = 0;
+    virtual bool ReadNativeWeights(NnueNetsource* nr) = 0;
+    virtual void WriteNativeWeights(NnueNetsource* nr) = 0;
     virtual uint32_t GetHash() = 0;
+    virtual uint32_t GetWeightLayout() = 0;
 };
 
 
@@ -925,10 +1038,16 @@ class NnueFeatureTransformer : public NnueLayer
 {
 public:
     alignas(64) int16_t bias[ftdims];
-    alignas(64) int16_t weight[ftdims * inputdims];
-    alignas(64) int32_t psqtWeights[psqtbuckets ? psqtbuckets * inputdims : 1];    // hack to avoid zero-sized array
-
-    NnueFeatureTransformer() : NnueLayer(NULL) {}
+    int16_t* weight;            // allocated or mapped from a network file in native layout
+    int32_t* psqtWeights;
+    bool mappedWeights;
+
+    NnueFeatureTransformer() : NnueLayer(NULL), weight(nullptr), psqtWeights(nullptr), mappedWeights(false) {}
+    ~NnueFeatureTransformer() { FreeWeights(); }
+    bool AllocWeights();
+    void FreeWeights();
+    void GetNativeLayout(NnueNativeHeader* header);
+    bool MapWeights(unsigned char* base, NnueNativeHeader* header);
     bool ReadFeatureWeights(NnueNetsource* nr, bool bpz);
     bool ReadWeights(NnueNetsource* nr) {
         if (previous) return previous->ReadWeights(nr);
@@ -939,6 +1058,16 @@ public:
         if (previous)
             previous->WriteWeights(nr);
     }
+    bool ReadNativeWeights(NnueNetsource* nr) {
+        return (previous ? previous->ReadNativeWeights(nr) : true);
+    }
+    void WriteNativeWeights(NnueNetsource* nr) {
+        if (previous)
+            previous->WriteNativeWeights(nr);
+    }
+    uint32_t GetWeightLayout() {
+        return 0;
+    }
     uint32_t GetFtHash(NnueType nt) {
         if (nt == NnueArchV5)
             return NNUEFEATUTEHASH_HalfKAv2_hm;
@@ -950,6 +1079,8 @@ public:
     };
 #ifdef STATISTICS
     void SwapWeights(unsigned int i1, unsigned int i2) {
+        if (mappedWeights)
+            AllocWeights();
         int16_t bias_temp = bias[i1];
         bias[i1] = bias[i2];
         bias[i2] = bias_temp;
@@ -976,9 +1107,19 @@ public:
         if (previous)
             previous->WriteWeights(nr);
     }
+    bool ReadNativeWeights(NnueNetsource* nr) {
+        return (previous ? previous->ReadNativeWeights(nr) : true);
+    }
+    void WriteNativeWeights(NnueNetsource* nr) {
+        if (previous)
+            previous->WriteNativeWeights(nr);
+    }
     uint32_t GetHash() {
         return NNUECLIPPEDRELUHASH + previous->GetHash();
     }
+    uint32_t GetWeightLayout() {
+        return previous->GetWeightLayout();
+    }
     void Propagate(int32_t *input, clipped_t *output);
 };
 
@@ -994,9 +1135,19 @@ public:
         if (previous)
             previous->WriteWeights(nr);
     }
+    bool ReadNativeWeights(NnueNetsource* nr) {
+        return (previous ? previous->ReadNativeWeights(nr) : true);
+    }
+    void WriteNativeWeights(NnueNetsource* nr) {
+        if (previous)
+            previous->WriteNativeWeights(nr);
+    }
     uint32_t GetHash() {
         return NNUECLIPPEDRELUHASH + previous->GetHash();
     }
+    uint32_t GetWeightLayout() {
+        return previous->GetWeightLayout();
+    }
     void Propagate(int32_t* input, clipped_t* output);
 };
 
@@ -1080,13 +1231,36 @@ public:
     bool ReadWeights(NnueNetsource* nr);
     bool OverflowPossible();
     void WriteWeights(NnueNetsource* nr);
+    bool ReadNativeWeights(NnueNetsource* nr) {
+        return (previous ? previous->ReadNativeWeights(nr) : true)
+            && nr->read((unsigned char*)bias, sizeof(bias))
+            && nr->read((unsigned char*)weight, sizeof(weight));
+    }
+    void WriteNativeWeights(NnueNetsource* nr) {
+        if (previous)
+            previous->WriteNativeWeights(nr);
+        nr->write((unsigned char*)bias, sizeof(bias));
+        nr->write((unsigned char*)weight, sizeof(weight));
+    }
     uint32_t GetHash() {
         return (NNUENETLAYERHASH + outputdims) ^ (previous->GetHash() >> 1) ^ (previous->GetHash() << 31);
     }
+    // Everything that determines the order of the weights in memory (see shuffleWeightIndex)
+    uint32_t GetWeightLayout() {
+        uint32_t layout = (useBigLayerPropagation ? 1 : 0) | (useShuffledWeights ? 2 : 0) | (InputSimdWidth << 2) | (MaxNumOutputRegs << 10)
+            | ((uint32_t)sizeof(weight_t) << 16);
+        return (layout + outputdims) ^ (previous->GetWeightLayout() >> 1) ^ (previous->GetWeightLayout() << 31);
+    }
     void Propagate(clipped_t *input, int32_t *output);
     void PropagateBigLayer(clipped_t* input, int32_t* output);
     void PropagateSmallLayer(clipped_t* input, int32_t* output);
     void PropagateNative(clipped_t* input, int32_t* output);
+    void PropagateBatch(clipped_t* input, int32_t* output, unsigned int n, size_t stride);
+    void PropagateSmallLayerBatch(clipped_t* input, int32_t* output, unsigned int n, size_t stride);
+    string GetPropagateName() {
+        return string(useSparsePropagation ? "PropagateSparse" : useSmallLayerPropagation ? "PropagateSmallLayer" : useBigLayerPropagation ? "PropagateBigLayer" : "PropagateNative")
+            + "<" + to_string(inputdims) + "," + to_string(outputdims) + ">";
+    }
     inline unsigned int shuffleWeightIndex(unsigned int idx)
     {
         if (useBigLayerPropagation)
@@ -1214,15 +1388,25 @@ public:
     void getAllHashes(chessposition* pos);
     U64 getPawnKingHash(chessposition* pos);
     U64 getMaterialHash(chessposition* pos);
+    U64 getChecksum();
 };
 
-#define TTBUCKETNUM 3
+// Geometry of the tt clusters used by the engine; can be changed at compile time,
+// e.g. -DTTCLUSTERENTRIES=6 -DTTCLUSTERBYTES=64 for one cluster per cache line
+#ifndef TTCLUSTERENTRIES
+#define TTCLUSTERENTRIES 3
+#endif
+#ifndef TTCLUSTERBYTES
+#define TTCLUSTERBYTES 32
+#endif
 
 typedef uint16_t hashupper_t;
 #define GETHASHUPPER(x) (hashupper_t)((x) >> (64 - sizeof(hashupper_t) * 8))
 
+// The data of a tt entry is packed into one 64bit word that is read and written atomically.
+// The key stored beside it is the hashupper xor'ed with a checksum of the data, so a slot
+// that was torn by concurrent writes of two threads fails the key test and is treated as a miss.
 struct ttentry {
-    hashupper_t hashupper;
     uint16_t movecode;
     int16_t value;
     int16_t staticeval;
@@ -1230,9 +1414,44 @@ struct ttentry {
     uint8_t boundAndAge;
 };
 
-struct transpositioncluster {
-    ttentry entry[TTBUCKETNUM];
-    uint8_t padding[(64 - sizeof(ttentry) * TTBUCKETNUM) % 16];
+static_assert(sizeof(ttentry) == sizeof(U64), "ttentry needs to fit into 64bit");
+
+// The age is excluded from the checksum so a tt hit can refresh it with a single write of the data word
+#define TTCHECKSUM(e) (hashupper_t)((e).movecode ^ (e).value ^ (e).staticeval ^ ((e).depth | (((e).boundAndAge & BOUNDMASK) << 8)))
+
+inline U64 ttpack(ttentry e) { U64 d; memcpy(&d, &e, sizeof(d)); return d; }
+inline ttentry ttunpack(U64 d) { ttentry e; memcpy(&e, &d, sizeof(e)); return e; }
+
+// Reference to a slot in the tt as returned by probeHash and used by addHash to store the search result
+struct ttslot {
+    atomic<U64>* data;
+    atomic<hashupper_t>* key;
+    // current content of the slot which may have changed since the probe; false if it no longer belongs to hash
+    bool load(U64 hash, ttentry* e) const {
+        *e = ttunpack(data->load(memory_order_relaxed));
+        return (key->load(memory_order_relaxed) ^ TTCHECKSUM(*e)) == GETHASHUPPER(hash);
+    }
+};
+
+// Header of a file that stores the tt across sessions
+struct tthashfileheader {
+    char magic[8];
+    U64 zobristchecksum;    // tt content is useless if the zobrist keys have changed
+    U64 size;               // number of clusters
+    uint32_t clusterbytes;
+    uint32_t numOfSearchShiftTwo;
+    uint8_t padding[32];
+};
+
+#define TTFILEMAGIC "RubiTT01"
+
+// A cluster of Entries slots (10 bytes each) aligned and padded to Bytes
+template <int Entries, int Bytes>
+struct alignas(Bytes) transpositioncluster {
+    static const int entries = Entries;
+    atomic<U64> data[Entries];
+    atomic<hashupper_t> key[Entries];
+    static_assert(Entries * (sizeof(U64) + sizeof(hashupper_t)) <= Bytes, "tt cluster too small for its entries");
 #ifdef SDEBUG
     U64 debugHash;
     int debugIndex;
@@ -1241,25 +1460,58 @@ struct transpositioncluster {
 };
 
 
+// Counters of tt usage; collected per thread with STATISTICS enabled and merged by the 'tt stats' command
+struct ttstatistic {
+    U64 probes;
+    U64 hits;
+    U64 collisions;             // hash move of a tt hit is not pseudo-legal in the position
+    U64 store_free;             // stored to an empty slot
+    U64 store_update;           // entry of the same position overwritten
+    U64 store_skipped;          // entry of the same position kept because of higher depth
+    U64 store_replace_old;      // entry from an older search replaced
+    U64 store_replace_current;  // entry from the current search replaced
+    void merge(const ttstatistic* s) {
+        probes += s->probes;
+        hits += s->hits;
+        collisions += s->collisions;
+        store_free += s->store_free;
+        store_update += s->store_update;
+        store_skipped += s->store_skipped;
+        store_replace_old += s->store_replace_old;
+        store_replace_current += s->store_replace_current;
+    }
+};
+
+#ifdef STATISTICS
+extern thread_local ttstatistic* ttstatsThread;
+#define TTSTATISTICSINC(x) (ttstatsThread ? (void)ttstatsThread->x++ : (void)0)
+#else
+#define TTSTATISTICSINC(x)
+#endif
+
 #define FIXMATESCOREPROBE(v,p) (MATEFORME(v) ? (v) - p : (MATEFOROPPONENT(v) ? (v) + p : v))
 #define FIXMATESCOREADD(v,p) (MATEFORME(v) ? (v) + p : (MATEFOROPPONENT(v) ? (v) - p : v))
 #define FIXDEPTHFROMTT(d) (d + TTDEPTH_OFFSET)
 
-class transposition
+template <class C>
+class transpositiontable
 {
 public:
-    transpositioncluster *table;
-    size_t size;
-    size_t sizemask;
-    uint8_t numOfSearchShiftTwo;
-    ~transposition();
-    void setSize(int *sizeMb);
+    C *table = nullptr;
+    size_t size = 0;
+    size_t sizemask = 0;
+    uint8_t numOfSearchShiftTwo = 0;
+    ~transpositiontable();
+    void setSize(int *sizeMb, string restorefile = "");
     void clean();
-    void addHash(ttentry* entry, U64 hash, int val, int16_t staticeval, int bound, int depth, uint16_t movecode);
+    bool saveToFile(string filename);
+    bool restoreFromFile(string filename);
+    void addHash(ttslot slot, U64 hash, int val, int16_t staticeval, int bound, int depth, uint16_t movecode);
     void printHashentry(U64 hash);
-    ttentry* probeHash(U64 hash, bool *bFound);
+    ttslot probeHash(U64 hash, bool *bFound, ttentry *entry);
     uint16_t getMoveCode(U64 hash);
     unsigned int getUsedinPermill();
+    void printStatistics(ttstatistic* counters);
     void nextSearch() { numOfSearchShiftTwo = (numOfSearchShiftTwo + AGEINC) & AGEMASK; }
 #ifdef SDEBUG
     void markDebugSlot(U64 h, int i) {
@@ -1267,12 +1519,12 @@ public:
     }
     int isDebugPosition(U64 h) { return (h != table[h & sizemask].debugHash) ? -1 : table[h & sizemask].debugIndex; }
     string debugGetPv(U64 h, int p) {
-        transpositioncluster* data = &table[h & sizemask];
-        for (int i = 0; i < TTBUCKETNUM; i++)
+        C* data = &table[h & sizemask];
+        for (int i = 0; i < C::entries; i++)
         {
-            ttentry *e = &(data->entry[i]);
-            if (e->hashupper == GETHASHUPPER(h))
-                return "Depth=" + to_string(e->depth) + " Value=" + to_string(FIXMATESCOREPROBE(e->value, p)) + "(" + to_string(e->boundAndAge & BOUNDMASK) + ")  pv=" + data->debugStoredBy;
+            ttentry e = ttunpack(data->data[i]);
+            if ((data->key[i] ^ TTCHECKSUM(e)) == GETHASHUPPER(h))
+                return "Depth=" + to_string(e.depth) + " Value=" + to_string(FIXMATESCOREPROBE(e.value, p)) + "(" + to_string(e.boundAndAge & BOUNDMASK) + ")  pv=" + data->debugStoredBy;
         }
         return "";
     }
@@ -1284,6 +1536,10 @@ public:
 #endif
 };
 
+typedef transpositioncluster<TTCLUSTERENTRIES, TTCLUSTERBYTES> ttcluster;
+
+class transposition : public transpositiontable<ttcluster> {};
+
 
 typedef struct pawnhashentry {
     uint32_t hashupper;
@@ -1299,7 +1555,7 @@ typedef struct pawnhashentry {
 class Pawnhash
 {
 public:
-    S_PAWNHASHENTRY *table;
+    S_PAWNHASHENTRY *table = nullptr;
     U64 sizemask;
     void setSize();
     void remove();
@@ -1307,8 +1563,53 @@ public:
 };
 
 
-#define MATERIALHASHSIZE 0x10000
-#define MATERIALHASHMASK (MATERIALHASHSIZE - 1)
+// Pawn hash shared by all threads; lockless by storing the hash xor'ed with the packed payload as verify key
+#define SHAREDPAWNHASHWORDS 7
+struct alignas(64) sharedpawnhashentry {
+    atomic<U64> key;
+    atomic<U64> data[SHAREDPAWNHASHWORDS];
+};
+
+class SharedPawnhash
+{
+public:
+    sharedpawnhashentry *table = nullptr;
+    U64 sizemask = 0;
+    void setSize(int sizeMb);
+    void remove();
+    bool probeHash(U64 hash, pawnhashentry *entry);
+    void addHash(U64 hash, pawnhashentry *entry);
+};
+
+extern SharedPawnhash sharedpwnhsh;
+
+
+#define MATERIALHASHBITS 16
+#define MATERIALHASHSIZE (1 << MATERIALHASHBITS)
+#define MATERIALKEYINC(p) (1ULL << ((p) << 2))
+#define MATERIALHASHINDEX(k) (((k) * 0x9e3779b97f4a7c15ULL) >> (64 - MATERIALHASHBITS))
+
+// Special evaluation of a known endgame; returns true if score (default SCOREDRAW) is valid
+typedef bool(*endgamefunc)(chessposition*, int*);
+
+// Everything of the classical eval that only depends on the material
+struct materialhashentry {
+    U64 key;
+    endgamefunc endgame;        // nullptr if there is no special evaluation for this material
+    int bishoppair[2];
+    int16_t phase;
+    uint8_t scale[2];           // scaling for side to scale without the check for opposite colored bishops
+    bool ocbCandidate;          // one bishop each and no other pieces; scaling depends on the colors of the bishops
+};
+
+class Materialhash
+{
+public:
+    materialhashentry *table = nullptr;
+    void setSize();
+    void remove();
+    materialhashentry* probeHash(chessposition *pos);
+};
 
 
 extern zobrist zb;
@@ -1547,6 +1848,17 @@ extern U64 rankMask[64];
 // 00000000
 extern U64 betweenMask[64][64];
 
+// lineMask[18][45]:
+// 00000001
+// 00000010
+// 00000100
+// 00001000
+// 00010000
+// 00x00000
+// 01000000
+// 10000000
+extern U64 lineMask[64][64];
+
 extern int squareDistance[64][64];
 
 struct chessmovestack
@@ -1565,6 +1877,23 @@ struct chessmovestack
     unsigned int threatSquare;
 };
 
+// Board data that is copied per ply in COPYMAKE mode; mapped to the board block of chessposition
+struct chessboardstack
+{
+    U64 materialkey;
+    U64 piece00[14];
+    uint8_t mailbox[BOARDSIZE];
+    int piececount;
+    int psqval;
+    int phcount;
+};
+
+#ifdef COPYMAKE
+#define MAKEUNMAKESTR "copy-make"
+#else
+#define MAKEUNMAKESTR "make/unmake"
+#endif
+
 #define MAXMOVELISTLENGTH 256   // for lists of possible pseudo-legal moves
 
 string moveToString(uint32_t mc);
@@ -1580,11 +1909,22 @@ public:
 	chessmovelist();
 	string toString();
 	void print();
-    chessmove* getNextMove(int minval = INT_MIN);
+    void sortByValue();
     uint32_t getAndRemoveNextMove();
 };
 
 
+// Attackers of the target squares of the captures already tested by seeCached(); captures of a node rarely
+// hit more than a few different squares, further squares are computed without caching
+#define SEEATTACKERSSIZE 8
+struct seeattackers
+{
+    int num;
+    uint8_t square[SEEATTACKERSSIZE];
+    U64 attackers[SEEATTACKERSSIZE];
+};
+
+
 enum MoveSelector_State { HASHMOVESTATE, TACTICALINITSTATE, TACTICALSTATE, KILLERMOVE1STATE, KILLERMOVE2STATE,
     COUNTERMOVESTATE, QUIETINITSTATE, QUIETSTATE, BADTACTICALSTATE, BADTACTICALEND, EVASIONINITSTATE, EVASIONSTATE };
 
@@ -1601,6 +1941,9 @@ public:
     uint32_t killermove2;
     uint32_t countermove;
     int margin;
+    int tacticalindex;
+    int badtacticalindex;
+    seeattackers seeAttackers;
     char padding[8];
 #ifdef SDEBUG
     int value;
@@ -1629,6 +1972,10 @@ extern U64 epthelper[64];
 struct SMagic {
     U64 mask;  // to mask relevant squares of both lines (no outer squares)
     U64 magic; // magic 64-bit factor
+#ifdef FANCYMAGICS
+    U64* attacks;   // start of this square's attacks in mSliderAttacks
+    int shift;      // 64 - number of relevant squares
+#endif
 };
 
 extern SMagic mBishopTbl[64];
@@ -1641,17 +1988,31 @@ extern SMagic mRookTbl[64];
 #include <immintrin.h>
 #define BISHOPINDEX(occ,i) (int)(_pext_u64(occ, mBishopTbl[i].mask))
 #define ROOKINDEX(occ,i) (int)(_pext_u64(occ, mRookTbl[i].mask))
+#elif defined(FANCYMAGICS)
+#define BISHOPINDEX(occ,i) (int)((((occ) & mBishopTbl[i].mask) * mBishopTbl[i].magic) >> mBishopTbl[i].shift)
+#define ROOKINDEX(occ,i) (int)((((occ) & mRookTbl[i].mask) * mRookTbl[i].magic) >> mRookTbl[i].shift)
 #else
 #define BISHOPINDEX(occ,i) (int)((((occ) & mBishopTbl[i].mask) * mBishopTbl[i].magic) >> (64 - BISHOPINDEXBITS))
 #define ROOKINDEX(occ,i) (int)((((occ) & mRookTbl[i].mask) * mRookTbl[i].magic) >> (64 - ROOKINDEXBITS))
 #endif
+
+#ifdef FANCYMAGICS
+// Sum of 2^(number of relevant squares) over all squares; 5248 + 102400 entries = 841KB
+#define BISHOPATTACKSIZE 5248
+#define ROOKATTACKSIZE 102400
+#define BISHOPATTACKS(m,x) (mBishopTbl[x].attacks[BISHOPINDEX(m,x)])
+#define ROOKATTACKS(m,x) (mRookTbl[x].attacks[ROOKINDEX(m,x)])
+
+extern U64 mSliderAttacks[BISHOPATTACKSIZE + ROOKATTACKSIZE];
+#else
 #define BISHOPATTACKS(m,x) (mBishopAttacks[x][BISHOPINDEX(m,x)])
 #define ROOKATTACKS(m,x) (mRookAttacks[x][ROOKINDEX(m,x)])
 
 extern U64 mBishopAttacks[64][1 << BISHOPINDEXBITS];
 extern U64 mRookAttacks[64][1 << ROOKINDEXBITS];
+#endif
 
-enum MoveType { QUIET = 1, CAPTURE = 2, PROMOTE = 4, TACTICAL = 6, ALL = 7 };
+enum MoveType { QUIET = 1, CAPTURE = 2, PROMOTE = 4, TACTICAL = 6, ALL = 7, LEGAL = 8, LEGALALL = 15 };
 enum RootsearchType { SinglePVSearch, MultiPVSearch };
 enum PruneType { Prune, MatePrune, NoPrune };
 
@@ -1659,6 +2020,7 @@ enum AttackType { FREE, OCCUPIED, OCCUPIEDANDKING };
 
 struct positioneval {
     pawnhashentry *phentry;
+    materialhashentry *mhentry;
     int kingattackpiececount[2][7] = { { 0 } };
     int kingringattacks[2] = { 0 };
     int kingattackers[2];
@@ -1672,6 +2034,8 @@ enum PvAbortType {
 };
 #endif
 
+// Finny tables: the accumulator of the last refreshed position per color and king square / king bucket
+// For HalfKAv2_hm the piece bitboards are stored mirrored if the king is on the queen side
 struct AccumulatorCache {
     U64 piece00[2][64][14];
     int16_t* accumulation;
@@ -1681,16 +2045,47 @@ struct AccumulatorCache {
 // Replace the occupied bitboards with the first two so far unused piece bitboards
 #define occupied00 piece00
 
+// History tables of a search thread; allocated apart from the board state to keep the chessposition object small
+struct searchhistory
+{
+    int16_t history[2][65][64][64];
+    int16_t counterhistory[14][64][14 * 64];
+    int16_t tacticalhst[7][64][6];
+    uint32_t countermove[14][64];
+    int16_t pawncorrectionhistory[2][CORRHISTSIZE];
+    int16_t nonpawncorrectionhistory[2][2][CORRHISTSIZE];
+};
+
+// Move lists and pv tables of a search thread indexed by ply; only the frames near the current ply are hot
+struct searchstack
+{
+    chessmovelist captureslist[MAXDEPTH];
+    chessmovelist quietslist[MAXDEPTH];
+    chessmovelist singularcaptureslist[MAXDEPTH];
+    chessmovelist singularquietslist[MAXDEPTH];
+    uint32_t quietMoves[MAXDEPTH][MAXMOVELISTLENGTH];
+    uint32_t tacticalMoves[MAXDEPTH][MAXMOVELISTLENGTH];
+    uint32_t pvtable[MAXDEPTH][MAXDEPTH];
+    uint32_t multipvtable[MAXMULTIPV][MAXDEPTH];
+    U64 nodespermove[0x10000];                      // init in prepare only for thread #0
+};
+
 class chessposition
 {
 public:
-    // everything up to member 'history' is copied from rootpos to every thread's position in prepareSearch()
+    // everything up to member 'hst' is copied from rootpos to every thread's position in prepareSearch()
     int ply;
-    int piececount;
+
+    // The following block is mapped/copied to the boardstack in COPYMAKE mode, so its important to keep the order
+    U64 materialkey;                // number of pieces of each type in 4 bits; key of the material hash
     U64 piece00[14];
+    uint8_t mailbox[BOARDSIZE];
+    int piececount;
+    int psqval;
+    int phcount;                    // weighted number of pieces (0..24)
+
     U64 attackedBy2[2];
     U64 attackedBy[2][7];
-    uint8_t mailbox[BOARDSIZE];
     U64 threats;
 
     // The following block is mapped/copied to the movestack, so its important to keep the order
@@ -1710,11 +2105,6 @@ public:
     int fullmovescounter;
     int prerootmovenum;
     chessmovelist rootmovelist;
-    uint32_t killer[MAXDEPTH][2];   // Hmmm. killer[0][] not initialized/reset to 0??
-    uint32_t bestFailingLow;        // Hmmm. bestFailingLow not initialized/reset to 0??
-    int failhighcount[MAXDEPTH];
-    int psqval;
-    int phcount;                    // weighted number of pieces (0..24)
     int contempt;
     int useTb;
     int useRootmoveScore;
@@ -1730,18 +2120,17 @@ public:
     uint32_t pvmovecode[MAXDEPTH];
 #endif
     //                   <--------  Everything up to here is copied from rootposition to every thread's position object
+    searchhistory* hst;                                 // allocated in constructor, reset via resetStats()
+    searchstack* sst;                                   // allocated in constructor
     // The following part of the chessposition object is reset via resetStats()
-    int16_t history[2][65][64][64];
-    int16_t counterhistory[14][64][14 * 64];
-    int16_t tacticalhst[7][64][6];
-    uint32_t countermove[14][64];
-    int16_t pawncorrectionhistory[2][CORRHISTSIZE];
-    int16_t nonpawncorrectionhistory[2][2][CORRHISTSIZE];
     int16_t* prerootconthistptr[6];
     int16_t* conthistptr[MAXDEPTH];
 
     chessmovestack prerootmovestack[PREROOTMOVES];      // explicit copy from rootpos up to frame prerootmovenum including first frame of regular stack
     chessmovestack movestack[MAXDEPTH];                 // frame 0 copied from rootpos
+#ifdef COPYMAKE
+    chessboardstack boardstack[MAXDEPTH];               // saved in prepareStack()
+#endif
     uint32_t prerootmovecode[PREROOTMOVES];             // explicit copy from rootpos up to frame prerootmovenum including first regular movecode
     uint32_t movecode[MAXDEPTH];
     uint16_t excludemovestack[MAXDEPTH];                // init in prepare only for excludemovestack[0]
@@ -1753,6 +2142,9 @@ public:
     U64 he_all;
 
     // The following members get an explicit init in prepareSearch()
+    uint32_t killer[MAXDEPTH][2];                   // init only for [0]
+    uint32_t bestFailingLow;
+    int failhighcount[MAXDEPTH];                    // init only for [0] and [1]
     U64 nodes;
     U64 tbhits;
     int nullmoveside;
@@ -1766,23 +2158,18 @@ public:
     // The following members (almost) don't need an init
     int seldepth;
     int sc;
-    U64 nodespermove[0x10000];                      // init in prepare only for thread #0
-    chessmovelist captureslist[MAXDEPTH];
-    chessmovelist quietslist[MAXDEPTH];
-    chessmovelist singularcaptureslist[MAXDEPTH];
-    chessmovelist singularquietslist[MAXDEPTH];
-    uint32_t pvtable[MAXDEPTH][MAXDEPTH];
-    uint32_t multipvtable[MAXMULTIPV][MAXDEPTH];
     uint32_t lastpv[MAXDEPTH];
     int CurrentMoveNum[MAXDEPTH];
     Pawnhash pwnhsh;                                    // init in alloc
+    Materialhash mtrlhsh;                               // init in alloc
+#ifdef STATISTICS
+    ttstatistic ttstats;                                // init in alloc
+#endif
     bool computationState[MAXDEPTH][2];
     int16_t* accumulation;
     int32_t* psqtAccumulation;
     AccumulatorCache accucache;
     DirtyPiece dirtypiece[MAXDEPTH];
-    uint32_t quietMoves[MAXDEPTH][MAXMOVELISTLENGTH];
-    uint32_t tacticalMoves[MAXDEPTH][MAXMOVELISTLENGTH];
     alignas(64) MoveSelector moveSelector[MAXDEPTH];
     MoveSelector extensionMoveSelector[MAXDEPTH];
 #ifdef SDEBUG
@@ -1806,6 +2193,10 @@ public:
     void copyPositionTuneSet(positiontuneset* from, evalparam* efrom, positiontuneset* to, evalparam* eto);
     string getCoeffString();
 #endif
+    chessposition();
+    ~chessposition();
+    chessposition(const chessposition&) = delete;
+    chessposition& operator=(const chessposition&) = delete;
     bool w2m();
     void BitboardSet(int index, PieceCode p);
     void BitboardClear(int index, PieceCode p);
@@ -1824,6 +2215,8 @@ public:
     U64 attackedByBB(int index, U64 occ);  // returns bitboard of all pieces of both colors attacking index square
     template <AttackType At> U64 isAttackedBy(int index, int col);    // returns the bitboard of cols pieces attacking the index square; At controls if pawns are moved to block or capture
     bool see(uint32_t move, int threshold);
+    inline bool seeExchange(int to, int value, U64 seeOccupied, U64 attacker);
+    bool seeCached(uint32_t move, int threshold, seeattackers& sa);
     int getBestPossibleCapture();
     void preparePosition();
     void prepareStack();
@@ -1838,16 +2231,17 @@ public:
     template <int Me> bool sliderAttacked(int index, U64 occ);
     bool moveGivesCheck(uint32_t c);  // simple and imperfect as it doesn't handle special moves and cases (mainly to avoid pruning of important moves)
     bool moveIsPseudoLegal(uint32_t c);     // test if move is possible in current position
+    bool moveIsLegal(uint32_t c);           // test if pseudo-legal move leaves the own king safe
     uint32_t shortMove2FullMove(uint16_t c); // transfer movecode from tt to full move code without checking if pseudoLegal
     int getpsqval(bool showDetails = false);  // only for eval trace
     template <EvalType Et, int Me> int getGeneralEval(positioneval *pe);
     int getFrcCorrection();
-    bool isEndgame(int *score);
+    void getMaterialInfo(materialhashentry *entry);
     template <EvalType Et, PieceType Pt, int Me> int getPieceEval(positioneval *pe);
     template <EvalType Et, int Me> int getLateEval(positioneval *pe);
     template <EvalType Et, int Me> void getPawnAndKingEval(pawnhashentry *entry);
     template <EvalType Et> int getEval();
-    int getScaling(int me);
+    int getScaling(materialhashentry *entry, int me);
     int getComplexity(int eval, pawnhashentry *phentry);
 
     template <RootsearchType RT> int rootsearch(int alpha, int beta, int depth, int inWindowLast, bool mateprune);
@@ -1866,10 +2260,12 @@ public:
     int correctEvalByHistory(int v);
     void resetStats();
     inline bool CheckForImmediateStop();
-    int CreateEvasionMovelist(chessmove* mstart);
-    template <MoveType Mt> int CreateMovelist(chessmove* mstart);
-    template <PieceType Pt, Color me> inline int CreateMovelistPiece(chessmove* mstart, U64 occ, U64 targets);
-    template <MoveType Mt, Color me> inline int CreateMovelistPawn(chessmove* mstart);
+    template <bool Legal = false> int CreateEvasionMovelist(chessmove* mstart);
+    template <MoveType Mt> int CreateMovelist(chessmove* mstart);  // pseudo-legal moves; with LEGAL only legal moves (all evasions if in check)
+    template <PieceType Pt, Color me, bool Legal> inline int CreateMovelistPiece(chessmove* mstart, U64 occ, U64 targets, U64 pinned);
+    template <MoveType Mt, Color me> inline int CreateMovelistPawn(chessmove* mstart, U64 pinned);
+    U64 pinnedPieces(int me);
+    bool epCaptureIsLegal(int from);
     template <Color me> inline int CreateMovelistCastle(chessmove* mstart);
     template <MoveType Mt> void evaluateMoves(chessmovelist* ml);
     int probe_wdl(int* success);
@@ -1889,6 +2285,7 @@ public:
     template <NnueType Nt, Color c> void HalfkpAppendChangedIndices(DirtyPiece* dp, NnueIndexList *add, NnueIndexList *remove);
     template <NnueType Nt, Color c, int N> bool GetAcccumulatorUpdateArray(int* updaterequest);
     template <NnueType Nt, Color c, unsigned int NnueFtHalfdims, unsigned int NnuePsqtBuckets, int N> void AccumulatorIncrementalUpdate(int* updaterequest);
+    template <NnueType Nt, Color c, unsigned int NnueFtHalfdims> void PrefetchFeatureWeights(int16_t* weight);
     template <NnueType Nt, Color c, unsigned int NnueFtHalfdims, unsigned int NnuePsqtBuckets> void AccumulatorRefresh();
     template <NnueType Nt, Color c, unsigned int NnueFtHalfdims, unsigned int NnuePsqtBuckets> void AccumulatorUpdate();
     template <NnueType Nt, Color c, unsigned int NnueFtHalfdims, unsigned int NnuePsqtBuckets> void AccumulatorSpeculativeUpdate();
@@ -1987,7 +2384,7 @@ public:
 };
 
 
-enum GuiToken { UNKNOWN, UCI, UCIDEBUG, ISREADY, SETOPTION, REGISTER, UCINEWGAME, POSITION, GO, STOP, WAIT, PONDERHIT, QUIT, EVAL, PERFT, BENCH, SPEEDTEST, TUNE, GENSFEN, CONVERT, LEARN, EXPORT, STATS };
+enum GuiToken { UNKNOWN, UCI, UCIDEBUG, ISREADY, SETOPTION, REGISTER, UCINEWGAME, POSITION, GO, STOP, WAIT, PONDERHIT, QUIT, EVAL, PERFT, BENCH, SPEEDTEST, EVALBENCH, TUNE, GENSFEN, CONVERT, LEARN, EXPORT, STATS, TT };
 
 const map<string, GuiToken> GuiCommandMap = {
     { "export", EXPORT },
@@ -2017,7 +2414,9 @@ const map<string, GuiToken> GuiCommandMap = {
     { "eval", EVAL },
     { "perft", PERFT },
     { "bench", BENCH },
-    { "speedtest", SPEEDTEST }
+    { "speedtest", SPEEDTEST },
+    { "evalbench", EVALBENCH },
+    { "tt", TT }
 };
 
 class engine;   //forward definition
@@ -2069,12 +2468,14 @@ enum ponderstate_t { NO, PONDERING };
 #define CPUNEON     (1 << 8)
 #define CPUARM64    (1 << 9)
 #define CPUDOTPROD  (1 << 10)
+#define CPUAVXVNNI  (1 << 11)
+#define CPUAVX512VNNI (1 << 12)
 
 class compilerinfo
 {
-    const string strCpuFeatures[11] = { "sse2","ssse3","popcnt","lzcnt","bmi1","avx2","bmi2", "avx512", "neon", "arm64", "dotprod"};
+    const string strCpuFeatures[13] = { "sse2","ssse3","popcnt","lzcnt","bmi1","avx2","bmi2", "avx512", "neon", "arm64", "dotprod", "avxvnni", "avx512vnni"};
 public:
-    const U64 binarySupports = 0ULL
+    static const U64 binarySupports = 0ULL
 #ifdef USE_POPCNT
         | CPUPOPCNT
 #endif
@@ -2104,6 +2505,12 @@ public:
 #endif
 #ifdef USE_DOTPROD
         | CPUDOTPROD
+#endif
+#ifdef USE_AVXVNNI
+        | CPUAVXVNNI
+#endif
+#ifdef USE_VNNI
+        | CPUAVX512VNNI
 #endif
         ;
 
@@ -2119,6 +2526,11 @@ public:
     int GetProcessId();
 };
 
+#ifdef DISPATCHARCH
+int dispatchedMain(int argc, char* argv[]);
+U64 dispatchedBinarySupports();
+#endif
+
 
 
 class engine
@@ -2144,6 +2556,7 @@ public:
     bool moveoutput;
     int stopLevel = ENGINETERMINATEDSEARCH;
     int Hash;
+    int PawnHash;
     int moveOverhead;
     int maxMeasuredGuiOverhead;
     int maxMeasuredEngineOverhead;
@@ -2154,6 +2567,7 @@ public:
     bool Syzygy50MoveRule = true;
     int SyzygyProbeLimit;
     string BookFile;
+    string HashFile;
     bool BookBestMove;
     int BookDepth;
     int Contempt;
@@ -2213,8 +2627,11 @@ public:
         else
             return "<unknown>";
     }
-#ifdef _WIN32
+#ifdef USE_LARGEPAGES
     bool allowlargepages;
+#endif
+#ifdef USE_LIBNUMA
+    bool numaInterleaveHash;
 #endif
     string name(bool full = true) {
         string sbinary = compinfo->PrintCpuFeatures(compinfo->binarySupports, true);
@@ -2235,7 +2652,7 @@ public:
     void communicate(string inputstring);
     void allocThreads();
     void getNodesAndTbhits(U64 *nodes, U64 *tbhits);
-    U64 perft(int depth, bool printsysteminfo = false);
+    U64 perft(int depth, bool printsysteminfo = false, bool fast = false);
     void bench(int constdepth, string epdfilename, int consttime, int startnum, bool openbench);
     void resetStats();
     void registerOptions();
@@ -2402,6 +2819,7 @@ public:
     mutex mtx;
     condition_variable cv;
     void (*jobFunc)(workingthread*);
+    void* jobArg = nullptr; // data of the job shared by all threads; set by run_job
     bool working = true;    // reset by idle_loop
     bool exit = false;
     int index;
@@ -2437,11 +2855,12 @@ public:
                 (*jobToRun)(this);
         }
     }
-    void run_job(void(*job)(workingthread*)) {
+    void run_job(void(*job)(workingthread*), void* arg = nullptr) {
         {
             unique_lock<mutex> lk(mtx);
             cv.wait(lk, [this] { return !working; });
             jobFunc = job;
+            jobArg = arg;
             working = true;
         }
         cv.notify_one();
@@ -2532,6 +2951,9 @@ public:
     U64 nnue_accupdate_cache;   // total number of already up-to-date accumulators
     U64 nnue_accupdate_inc;     // total number of incremental updates
     U64 nnue_accupdate_full;    // total number of full updates
+    U64 nnue_refresh_features;  // total number of features added or removed by full updates using the accumulator cache
+    U64 nnue_refresh_active;    // total number of active features in full updates (cost without the cache)
+    U64 nnue_refresh_slot[2][64];   // number of full updates per color and accumulator cache slot
 
 #define MAXSTATDEPTH 30
 #define MAXSTATMOVES 128
@@ -2607,9 +3029,13 @@ namespace Simd {
 #if USE_AVX512
     // 512bit intrinsics
     inline void m512_add_dpbusd_32(__m512i& acc, __m512i a, __m512i b) {
+#if defined (USE_VNNI)
+        acc = _mm512_dpbusd_epi32(acc, a, b);
+#else
         __m512i product0 = _mm512_maddubs_epi16(a, b);
         product0 = _mm512_madd_epi16(product0, _mm512_set1_epi16(1));
         acc = _mm512_add_epi32(acc, product0);
+#endif
     }
 
     inline void m512_add_dpbusd_32x2(__m512i& acc, __m512i a0, __m512i b0,  __m512i a1, __m512i b1) {
@@ -2653,19 +3079,33 @@ namespace Simd {
 #endif
 
 #ifdef USE_AVX2
-    // 256bit intrinsics
+    // 256bit intrinsics; with AVX512-VNNI the EVEX encoded dpbusd is used, else the VEX encoded one of AVX-VNNI
     inline void m256_add_dpbusd_32(__m256i& acc, __m256i a, __m256i b) {
+#if defined (USE_VNNI)
+        acc = _mm256_dpbusd_epi32(acc, a, b);
+#elif defined (USE_AVXVNNI)
+        acc = _mm256_dpbusd_avx_epi32(acc, a, b);
+#else
         __m256i product0 = _mm256_maddubs_epi16(a, b);
         product0 = _mm256_madd_epi16(product0, _mm256_set1_epi16(1));
         acc = _mm256_add_epi32(acc, product0);
+#endif
     }
 
     inline void m256_add_dpbusd_32x2(__m256i& acc, __m256i a0, __m256i b0, __m256i a1, __m256i b1) {
+#if defined (USE_VNNI)
+        acc = _mm256_dpbusd_epi32(acc, a0, b0);
+        acc = _mm256_dpbusd_epi32(acc, a1, b1);
+#elif defined (USE_AVXVNNI)
+        acc = _mm256_dpbusd_avx_epi32(acc, a0, b0);
+        acc = _mm256_dpbusd_avx_epi32(acc, a1, b1);
+#else
         __m256i product0 = _mm256_maddubs_epi16(a0, b0);
         __m256i product1 = _mm256_maddubs_epi16(a1, b1);
         product0 = _mm256_adds_epi16(product0, product1);
         product0 = _mm256_madd_epi16(product0, _mm256_set1_epi16(1));
         acc = _mm256_add_epi32(acc, product0);
+#endif
     }
 
     inline int m256_hadd(__m256i sum, int bias) {
@@ -45,6 +45,21 @@ int squareDistance[64][64];  // decreased by 1 for directly indexing evaluation
 alignas(64) int psqtable[14][64];
 
 
+chessposition::chessposition()
+{
+    hst = (searchhistory*)allocalign64(sizeof(searchhistory));
+    sst = new(allocalign64(sizeof(searchstack))) searchstack;
+}
+
+
+chessposition::~chessposition()
+{
+    sst->~searchstack();
+    freealigned64(sst);
+    freealigned64(hst);
+}
+
+
 bool chessposition::w2m()
 {
     return !(state & S2MMASK);
@@ -307,6 +322,13 @@ void chessposition::prepareStack()
     myassert(ply >= 0 && ply < MAXDEPTH, this, 1, ply);
     // copy stack related data directly to stack
     memcpy(&movestack[ply], &state, sizeof(chessmovestack));
+#ifdef COPYMAKE
+    static_assert(offsetof(chessposition, phcount) - offsetof(chessposition, materialkey) == offsetof(chessboardstack, phcount),
+        "board block of chessposition doesn't match chessboardstack");
+    static_assert(offsetof(chessposition, attackedBy2) - offsetof(chessposition, materialkey) >= sizeof(chessboardstack),
+        "copying chessboardstack overwrites data behind the board block of chessposition");
+    memcpy(&boardstack[ply], &materialkey, sizeof(chessboardstack));
+#endif
 }
 
 
@@ -522,35 +544,35 @@ string chessposition::toFen()
 
 void chessposition::updateMultiPvTable(int pvindex, uint32_t mc)
 {
-    uint32_t *table = multipvtable[pvindex];
+    uint32_t *table = sst->multipvtable[pvindex];
     table[0] = mc;
     int i = 0;
-    while (pvtable[1][i])
+    while (sst->pvtable[1][i])
     {
-        table[i + 1] = pvtable[1][i];
+        table[i + 1] = sst->pvtable[1][i];
         i++;
     }
     table[++i] = 0;
 
     // replicate best multipv to pvtable
     if (pvindex == 0)
-        memcpy(pvtable[0], table, (i + 1) * sizeof(uint32_t));
+        memcpy(sst->pvtable[0], table, (i + 1) * sizeof(uint32_t));
 }
 
 
 void chessposition::updatePvTable(uint32_t mc, bool recursive)
 {
-    pvtable[ply][0] = mc;
+    sst->pvtable[ply][0] = mc;
     int i = 0;
     if (recursive)
     {
-        while (pvtable[ply + 1][i])
+        while (sst->pvtable[ply + 1][i])
         {
-            pvtable[ply][i + 1] = pvtable[ply + 1][i];
+            sst->pvtable[ply][i + 1] = sst->pvtable[ply + 1][i];
             i++;
         }
     }
-    pvtable[ply][i + 1] = 0;
+    sst->pvtable[ply][i + 1] = 0;
 }
 
 string chessposition::getPv(uint32_t *table)
@@ -642,8 +664,12 @@ void chessposition::pvdebugout()
 
 
 // shameless copy from https://www.chessprogramming.org/Magic_Bitboards
+#ifdef FANCYMAGICS
+alignas(64) U64 mSliderAttacks[BISHOPATTACKSIZE + ROOKATTACKSIZE];
+#else
 alignas(64) U64 mBishopAttacks[64][1 << BISHOPINDEXBITS];
 alignas(64) U64 mRookAttacks[64][1 << ROOKINDEXBITS];
+#endif
 
 alignas(64) SMagic mBishopTbl[64];
 alignas(64) SMagic mRookTbl[64];
@@ -682,6 +708,56 @@ U64 getOccupiedFromMBIndex(int j, U64 mask)
 }
 
 
+#ifdef FANCYMAGICS
+// Precalculated magics for the variable shift (64 - number of relevant squares) found by trial of sparse random numbers
+const U64 bishopfancymagics[] = {
+    0x1004301021102080, 0x0010108088828201, 0x4810012210200300, 0x0408084100200140, 0x2041104000000200, 0x0003100815002500, 0x00840c0119480401, 0x2249004104200200,
+    0x8001400421220200, 0x0840046408004100, 0x0020084085020040, 0x8020042402828801, 0x0214040420001400, 0xa800209004201091, 0x0a00004210042213, 0x0000c2005402480a,
+    0x0104004044040410, 0xa010010911180281, 0x0008001c10c01200, 0x1008000420441080, 0x8006000400a20200, 0x8882012108014400, 0x0042020098014800, 0x0180424112480432,
+    0x0002900440500200, 0x208104b010104220, 0x2081300088018024, 0x0104004044010003, 0x802d010020104000, 0x6008020141104202, 0x01080a0129010102, 0x0304084004220200,
+    0x201824400e100208, 0x0308010461484820, 0x2000109000020400, 0x8908240400080120, 0x0004010010140040, 0x1090020023420080, 0x0001042400212112, 0x0402009200430061,
+    0x2000820820404001, 0x0001044104002040, 0x0012012601000810, 0x8020102011000810, 0x040040810a008100, 0x0102208122020900, 0x410401a216008400, 0xc00800a404400080,
+    0x0000680248200002, 0x6010b30c10040108, 0x9041004208040010, 0x0200220884041840, 0x8001611202020100, 0x4000112002442000, 0x1025104405040000, 0x10200202021be002,
+    0x6400240208112821, 0x8282150082108280, 0x6001202840441021, 0x2010400100420200, 0x001a0000120a0600, 0x0004060a10100080, 0x0040400488008900, 0x0008501024822280
+};
+
+const U64 rookfancymagics[] = {
+    0x8200108041020020, 0x018030c000802002, 0x0200088022004010, 0x0480080080c41000, 0x0600041008208200, 0x8900010008340006, 0x8880020000801100, 0x23000284a0420100,
+    0x0402800480400020, 0x2000400040201000, 0x8180801000200080, 0x5012000820420010, 0x8004808008000400, 0x3080808004000200, 0x4409000411002200, 0x0001000062008100,
+    0x0080004020004001, 0x2010004000402000, 0x1020808020001000, 0x0200818018011000, 0x1080808008000401, 0x0206008004008002, 0x0403010100040200, 0x6820020000884904,
+    0x0038208180084000, 0xc400810100400024, 0x0008104900200100, 0x2080100080800800, 0x0020850100080190, 0x8004010040020040, 0xd101020400108841, 0x2800008200050c44,
+    0x0108400820800080, 0x4840002081004100, 0x0a00108042002203, 0x2402801002800800, 0x1041000801000410, 0x0400040080800200, 0x0000011044004208, 0x1280a10042000084,
+    0x0080400080208000, 0x0000a0005000c008, 0x0808460080220010, 0x000021001001000b, 0x0001000408010010, 0x3402000204008080, 0x0200010210040008, 0x0080008408460001,
+    0x00c0244010800080, 0x4008884000201080, 0x02060045a0128200, 0x2088100080080080, 0x0000480100100500, 0x0009000208040100, 0x0080811008020400, 0x5000004104008200,
+    0x1102208001041841, 0x820120824000d301, 0x0890084410200101, 0x0031000409201001, 0x0011001008000443, 0x0002008408011002, 0x0012320110083084, 0x0406008044211402
+};
+
+
+// Fill the attacks of a slider on square 'from' into the compact table starting at 'attacks' and return the number of entries
+static int initFancyMagic(SMagic* sm, int from, U64* attacks, const int* deltas, U64 magic)
+{
+    int bits = POPCOUNT(sm->mask);
+    int size = 1 << bits;
+
+    sm->magic = magic;
+    sm->attacks = attacks;
+    sm->shift = 64 - bits;
+    for (int j = 0; j < size; j++)
+    {
+        U64 occ = getOccupiedFromMBIndex(j, sm->mask);
+        U64 attack = 0ULL;
+        for (int d = 0; d < 4; d++)
+            attack |= getAttacks(from, occ, deltas[d]);
+#if defined(USE_BMI2) && (defined(_M_X64) || defined(IS_64BIT))
+        attacks[_pext_u64(occ, sm->mask)] = attack;
+#else
+        attacks[(occ * magic) >> sm->shift] = attack;
+#endif
+    }
+    return size;
+}
+#endif
+
 
 // Use precalculated macigs for better to save time at startup
 const U64 bishopmagics[] = {
@@ -710,6 +786,12 @@ const U64 rookmagics[] = {
 void initBitmaphelper()
 {
     int to;
+#ifdef FANCYMAGICS
+    const int bishopdeltas[] = { -7, 7, -9, 9 };
+    const int rookdeltas[] = { -1, 1, -8, 8 };
+    U64* bishopattacks = mSliderAttacks;
+    U64* rookattacks = mSliderAttacks + BISHOPATTACKSIZE;
+#endif
 
     initPsqtable();
     for (int from = 0; from < 64; from++)
@@ -846,6 +928,10 @@ void initBitmaphelper()
                 mBishopTbl[from].mask |= BITSET(j);
         }
 
+#ifdef FANCYMAGICS
+        bishopattacks += initFancyMagic(&mBishopTbl[from], from, bishopattacks, bishopdeltas, bishopfancymagics[from]);
+        rookattacks += initFancyMagic(&mRookTbl[from], from, rookattacks, rookdeltas, rookfancymagics[from]);
+#else
         // mBishopTbl[from].magic = getMagicCandidate(mBishopTbl[from].mask);
         mBishopTbl[from].magic = bishopmagics[from];
 
@@ -869,6 +955,7 @@ void initBitmaphelper()
             int hashindex = ROOKINDEX(occ, from);
             mRookAttacks[from][hashindex] = attack;
         }
+#endif
 
         epthelper[from] = 0ULL;
         if (RANK(from) == 3 || RANK(from) == 4)
@@ -891,6 +978,7 @@ void chessposition::BitboardSet(int index, PieceCode p)
     occupied00[s2m] |= BITSET(index);
     psqval += psqtable[p][index];
     phcount += phasefactor[p >> 1];
+    materialkey += MATERIALKEYINC(p);
 }
 
 
@@ -903,6 +991,7 @@ void chessposition::BitboardClear(int index, PieceCode p)
     occupied00[s2m] ^= BITSET(index);
     psqval -= psqtable[p][index];
     phcount -= phasefactor[p >> 1];
+    materialkey -= MATERIALKEYINC(p);
 }
 
 
@@ -1062,12 +1151,20 @@ bool chessposition::see(uint32_t move, int threshold)
 
     // Now things get a little more complicated...
     U64 seeOccupied = ((occupied00[0] | occupied00[1]) ^ BITSET(from)) | BITSET(to);
-    U64 potentialRookAttackers = (piece00[WROOK] | piece00[BROOK] | piece00[WQUEEN] | piece00[BQUEEN]);
-    U64 potentialBishopAttackers = (piece00[WBISHOP] | piece00[BBISHOP] | piece00[WQUEEN] | piece00[BQUEEN]);
 
     // Get attackers excluding the already moved piece
     U64 attacker = attackedByBB(to, seeOccupied) & seeOccupied;
 
+    return seeExchange(to, value, seeOccupied, attacker);
+}
+
+
+// the exchange sequence on square 'to' after the first capture; value is the balance if the opponent doesn't recapture
+inline bool chessposition::seeExchange(int to, int value, U64 seeOccupied, U64 attacker)
+{
+    U64 potentialRookAttackers = (piece00[WROOK] | piece00[BROOK] | piece00[WQUEEN] | piece00[BQUEEN]);
+    U64 potentialBishopAttackers = (piece00[WBISHOP] | piece00[BBISHOP] | piece00[WQUEEN] | piece00[BQUEEN]);
+    int nextPiece;
     int s2m = (state & S2MMASK) ^ S2MMASK;
 
     while (true)
@@ -1108,6 +1205,52 @@ bool chessposition::see(uint32_t move, int threshold)
 }
 
 
+// see() for a move of a tactical list; the attackers of a target square are computed only once for all
+// moves to this square and cached in sa. The moved piece can only uncover sliders on its own line
+// so only this slider type is added per move
+bool chessposition::seeCached(uint32_t move, int threshold, seeattackers& sa)
+{
+    int from = GETFROM(move);
+    int to = GETCORRECTTO(move);
+    int value = GETTACTICALVALUE(move) - threshold;
+
+    if (value < 0)
+        return false;
+
+    int nextPiece = (ISPROMOTION(move) ? GETPROMOTION(move) : GETPIECE(move)) >> 1;
+    value -= materialvalue[nextPiece];
+    if (value >= 0)
+        return true;
+
+    U64 occupied = occupied00[0] | occupied00[1];
+    U64 attacker;
+    int i = 0;
+    while (i < sa.num && sa.square[i] != to)
+        i++;
+    if (i < sa.num)
+    {
+        attacker = sa.attackers[i];
+    }
+    else {
+        attacker = attackedByBB(to, occupied);
+        if (sa.num < SEEATTACKERSSIZE)
+        {
+            sa.square[sa.num] = to;
+            sa.attackers[sa.num++] = attacker;
+        }
+    }
+
+    U64 seeOccupied = (occupied ^ BITSET(from)) | BITSET(to);
+    if (RANK(from) == RANK(to) || FILE(from) == FILE(to))
+        attacker |= ROOKATTACKS(seeOccupied, to) & (piece00[WROOK] | piece00[BROOK] | piece00[WQUEEN] | piece00[BQUEEN]);
+    else if (lineMask[from][to])
+        attacker |= BISHOPATTACKS(seeOccupied, to) & (piece00[WBISHOP] | piece00[BBISHOP] | piece00[WQUEEN] | piece00[BQUEEN]);
+    attacker &= seeOccupied;
+
+    return seeExchange(to, value, seeOccupied, attacker);
+}
+
+
 
 int chessposition::getBestPossibleCapture()
 {
@@ -26,13 +26,15 @@ using namespace rubichess;
 #if defined _MSC_VER && !defined(__clang_major__)
 #include <intrin.h>
 #define CPUID(x,i) __cpuid(x, i)
+#define CPUIDEX(x,i,s) __cpuidex(x, i, s)
 #endif
 
 #if defined(__MINGW64__) || defined(__gnu_linux__) || defined(__clang_major__) || defined(__GNUC__)
 #include <cpuid.h>
 #define CPUID(x,i) cpuid(x, i)
-static void cpuid(int32_t out[4], int32_t x) {
-    __cpuid_count(x, 0, out[0], out[1], out[2], out[3]);
+#define CPUIDEX(x,i,s) cpuid(x, i, s)
+static void cpuid(int32_t out[4], int32_t x, int32_t s = 0) {
+    __cpuid_count(x, s, out[0], out[1], out[2], out[3]);
 }
 #endif
 
@@ -89,6 +91,15 @@ void compilerinfo::GetSystemInfo()
             if (CPUInfo[1] & (1 << 8)) machineSupports |= CPUBMI2;
             if (CPUInfo[1] & (1 << 5)) machineSupports |= CPUAVX2;
             if (CPUInfo[1] & ((1 << 16) | (1 << 30))) machineSupports |= CPUAVX512; // AVX512F + AVX512BW needed
+            if ((machineSupports & CPUAVX512) && (CPUInfo[1] & (1U << 31)) && (CPUInfo[2] & (1 << 11)))
+                machineSupports |= CPUAVX512VNNI; // AVX512VL + AVX512_VNNI
+            if (CPUInfo[0] >= 1)
+            {
+                // number of subleafs > 0 => check subleaf 1 for AVX-VNNI
+                int CPUInfo1[4];
+                CPUIDEX(CPUInfo1, 7, 1);
+                if (CPUInfo1[0] & (1 << 4)) machineSupports |= CPUAVXVNNI;
+            }
         }
     }
 
@@ -138,6 +149,9 @@ void compilerinfo::GetSystemInfo()
 
 #ifndef CPUTEST
     U64 supportedButunused = machineSupports & ~binarySupports;
+    if (binarySupports & CPUAVX512VNNI)
+        // AVX512-VNNI includes the 256bit dot product of AVX-VNNI
+        supportedButunused &= ~CPUAVXVNNI;
     if (supportedButunused)
         cout << "info string Warning! Binary not optimal for this machine. Unused cpu features: " + PrintCpuFeatures(supportedButunused) + ". Please use correct binary for best performance.\n";
 #endif
@@ -185,6 +199,45 @@ string compilerinfo::PrintCpuFeatures(U64 f, bool onlyHighest)
 
 #ifdef CPUTEST
 
+#ifdef DISPATCHER
+// The archs of the multi arch build from best to worst; keep in sync with DISPATCHARCHS in the Makefile
+#define DISPATCHDECLARE(a) namespace rubichess_ ## a { int dispatchedMain(int argc, char* argv[]); U64 dispatchedBinarySupports(); }
+#define DISPATCHENTRY(a) { rubichess_ ## a::dispatchedBinarySupports, rubichess_ ## a::dispatchedMain }
+DISPATCHDECLARE(avx512vnni)
+DISPATCHDECLARE(avx512)
+DISPATCHDECLARE(avxvnni)
+DISPATCHDECLARE(bmi2)
+DISPATCHDECLARE(avx2)
+DISPATCHDECLARE(modern)
+DISPATCHDECLARE(sse2)
+
+int main(int argc, char* argv[])
+{
+    struct {
+        U64 (*binarySupports)();
+        int (*main)(int argc, char* argv[]);
+    } archs[] = {
+        DISPATCHENTRY(avx512vnni),
+        DISPATCHENTRY(avx512),
+        DISPATCHENTRY(avxvnni),
+        DISPATCHENTRY(bmi2),
+        DISPATCHENTRY(avx2),
+        DISPATCHENTRY(modern),
+        DISPATCHENTRY(sse2)
+    };
+
+    // GetSystemInfo already removed bmi2 from the supported features of AMD cpus before Zen3
+    compilerinfo ci;
+    for (auto& arch : archs)
+        if (!(arch.binarySupports() & ~ci.machineSupports))
+            return arch.main(argc, argv);
+
+    cout << "info string Error! None of the archs in this binary is compatible with this machine.\n";
+    return -1;
+}
+
+#else
+
 int main()
 {
     compilerinfo ci;
@@ -194,3 +247,4 @@ int main()
 }
 
 #endif
+#endif
@@ -39,31 +39,75 @@ void engineHeader()
 //
 // callbacks for ucioptions
 //
-#ifdef _WIN32
+static void uciSetThreads()
+{
+    en.allocThreads();
+}
+
+static string hashFileName()
+{
+    return (en.HashFile == "<empty>" ? "" : en.HashFile);
+}
+
+static void uciSetHash()
+{
+    tp.setSize(&en.Hash, hashFileName());
+}
+
+static void uciSetPawnHash()
+{
+    bool wasShared = (sharedpwnhsh.table != nullptr);
+    sharedpwnhsh.setSize(en.PawnHash);
+    if (wasShared != (sharedpwnhsh.table != nullptr))
+        // threads need their private pawn hash only without the shared one
+        en.allocThreads();
+}
+
+#ifdef USE_LIBNUMA
+static void uciSetNumaInterleaveHash()
+{
+    if (!tp.size)
+        // Hash not allocated yet
+        return;
+    uciSetHash();
+    guiCom << "info string " + numa_configuration() + "\n";
+}
+#endif
+
+#ifdef USE_LARGEPAGES
+static void uciSetNnuePath();
+
 static void uciAllowLargePages()
 {
     if (!en.Hash)
+        // Nothing allocated yet
         return;
-    printf("info string Reallocating hash table %s large pages\n", en.allowlargepages ? "using" : "without");
-    // This gets a little tricky
-    // First reset to old value and free the TT
-    en.allowlargepages = !en.allowlargepages;
-    tp.setSize(0);
-
-    // Now back to new value and allocate TT
-    en.allowlargepages = !en.allowlargepages;
-    tp.setSize(&en.Hash);
+    guiCom << "info string Reallocating hash tables and network " + string(en.allowlargepages ? "using" : "without") + " large pages\n";
+    uciSetNnuePath();
+    sharedpwnhsh.setSize(en.PawnHash);
+    en.allocThreads();
+    tp.setSize(&en.Hash, hashFileName());
 }
 #endif
 
-static void uciSetThreads()
+static void uciSetHashFile()
 {
-    en.allocThreads();
+    string filename = hashFileName();
+    if (filename == "")
+        return;
+    if (tp.restoreFromFile(filename))
+        guiCom << "info string Restored hash from " + filename + "\n";
+    else
+        guiCom << "info string Cannot restore hash from " + filename + " (missing or not matching); it will be written on quit.\n";
 }
 
-static void uciSetHash()
+static void uciSaveHash()
 {
-    tp.setSize(&en.Hash);
+    string filename = hashFileName();
+    if (filename == "")
+        return;
+    if (!tp.saveToFile(filename))
+        guiCom << "info string Cannot write hash to " + filename + "\n";
 }
 
 static void uciClearHash()
@@ -183,22 +227,28 @@ engine::~engine()
     Threads = 0;
     allocThreads();
     rootposition.pwnhsh.remove();
+    sharedpwnhsh.remove();
     NnueRemove();
 }
 
 
 void engine::registerOptions()
 {
+#ifdef USE_LARGEPAGES
+    // first option as it is used for the allocation of network and hash tables
+    ucioptions.Register(&allowlargepages, "Allow Large Pages", ucicheck, "true", 0, 0, uciAllowLargePages);
+#endif
 #ifndef NNUEINCLUDED
     ucioptions.Register(&NnueNetpath, "NNUENetpath", ucistring, "<Default>", 0, 0, uciSetNnuePath);
 #endif
     ucioptions.Register(&usennue, "Use_NNUE", ucicheck, "true", 0, 0, uciSetNnuePath);
     ucioptions.Register(&LogFile, "LogFile", ucistring, "", 0, 0, uciSetLogFile);
-#ifdef _WIN32
-    ucioptions.Register(&allowlargepages, "Allow Large Pages", ucicheck, "true", 0, 0, uciAllowLargePages);
-#endif
     ucioptions.Register(&Threads, "Threads", ucispin, "1", 1, MAXTHREADS, uciSetThreads);  // order is important as the pawnhash depends on Threads > 0
+#ifdef USE_LIBNUMA
+    ucioptions.Register(&numaInterleaveHash, "NUMA Interleave Hash", ucicheck, "false", 0, 0, uciSetNumaInterleaveHash);
+#endif
     ucioptions.Register(&Hash, "Hash", ucispin, to_string(DEFAULTHASH), 1, MAXHASH, uciSetHash);
+    ucioptions.Register(&PawnHash, "PawnHash", ucispin, "0", 0, MAXPAWNHASH, uciSetPawnHash);   // 0 = private pawn hash per thread
     ucioptions.Register(&moveOverhead, "Move_Overhead", ucispin, "100", 0, 5000, nullptr);
     ucioptions.Register(&MultiPV, "MultiPV", ucispin, "1", 1, MAXMULTIPV, nullptr);
     ucioptions.Register(&ponder, "Ponder", ucicheck, "false");
@@ -210,6 +260,8 @@ void engine::registerOptions()
     ucioptions.Register(&BookDepth, "BookDepth", ucispin, "255", 0, 255);
     ucioptions.Register(&chess960, "UCI_Chess960", ucicheck, "false");
     ucioptions.Register(nullptr, "Clear Hash", ucibutton, "", 0, 0, uciClearHash);
+    ucioptions.Register(&HashFile, "HashFile", ucistring, "<empty>", 0, 0, uciSetHashFile);
+    ucioptions.Register(nullptr, "Save Hash", ucibutton, "", 0, 0, uciSaveHash);
     ucioptions.Register(&Contempt, "Contempt", ucispin, "0", -100, 100, uciSetContempt);
     ucioptions.Register(&RatingAdv, "UCI_RatingAdv", ucispin, "0", -10000, 10000, uciSetContempt);
     ucioptions.Register(&ContemptRatio, "ContemptRatio", ucispin, "4", 0, 16, uciSetContempt);
@@ -220,17 +272,27 @@ void initThread(workingthread* thr)
 {
     void* buffer = allocalign64(sizeof(chessposition));
     chessposition* pos = thr->pos = new(buffer) chessposition;
-    pos->pwnhsh.setSize();
+    if (!sharedpwnhsh.table)
+        pos->pwnhsh.setSize();
+    pos->mtrlhsh.setSize();
     pos->accumulation = NnueCurrentArch ? NnueCurrentArch->CreateAccumulationStack() : nullptr;
     pos->psqtAccumulation = NnueCurrentArch ? NnueCurrentArch->CreatePsqtAccumulationStack() : nullptr;
     if (NnueCurrentArch)
         NnueCurrentArch->CreateAccumulationCache(pos);
+#ifdef STATISTICS
+    memset(&pos->ttstats, 0, sizeof(ttstatistic));
+    ttstatsThread = &pos->ttstats;
+#endif
 }
 
 void cleanupThread(workingthread* thr)
 {
     chessposition* pos = thr->pos;
+#ifdef STATISTICS
+    ttstatsThread = nullptr;
+#endif
     pos->pwnhsh.remove();
+    pos->mtrlhsh.remove();
     freealigned64(pos->accumulation);
     freealigned64(pos->psqtAccumulation);
     freealigned64(pos->accucache.accumulation);
@@ -293,15 +355,10 @@ void engine::resetStats()
 
 void chessposition::resetStats()
 {
-    memset(history, 0, sizeof(chessposition::history));
-    memset(tacticalhst, 0, sizeof(chessposition::tacticalhst));
-    memset(counterhistory, 0, sizeof(chessposition::counterhistory));
-    memset(countermove, 0, sizeof(chessposition::countermove));
+    memset(hst, 0, sizeof(searchhistory));
     memset(conthistptr, 0, sizeof(chessposition::conthistptr));
-    memset(pawncorrectionhistory, 0, sizeof(chessposition::pawncorrectionhistory));
-    memset(nonpawncorrectionhistory, 0, sizeof(chessposition::nonpawncorrectionhistory));
     for (int i = 0; i < 6; i++)
-        prerootconthistptr[i] = counterhistory[0][0];
+        prerootconthistptr[i] = hst->counterhistory[0][0];
     he_yes = 0ULL;
     he_all = 0ULL;
     he_threshold = 7700;
@@ -675,7 +732,7 @@ void engine::communicate(string inputstring)
             case PERFT:
                 if (ci < cs) {
                     try { maxdepth = stoi(commandargs[ci++]); } catch (...) {}
-                    perft(max(1, maxdepth), true);
+                    perft(max(1, maxdepth), true, ci < cs && commandargs[ci] == "fast");
                 }
                 break;
             case BENCH:
@@ -697,6 +754,31 @@ void engine::communicate(string inputstring)
             case SPEEDTEST:
             {
                 int threads = 0, hash = 0, time = 0;
+                if (ci < cs && commandargs[ci] == "tt")
+                {
+                    // speedtest tt [hash] [depth] compares the tt cluster layouts
+                    int depth = 0;
+                    ci++;
+                    if (ci < cs)
+                        try { hash = stoi(commandargs[ci++]); }
+                    catch (...) {}
+                    if (ci < cs)
+                        try { depth = stoi(commandargs[ci++]); }
+                    catch (...) {}
+                    ttspeedtest(hash, depth);
+                    break;
+                }
+                if (ci < cs && commandargs[ci] == "eval")
+                {
+                    // speedtest eval [positions] compares single and batched NNUE evaluation
+                    int count = 0;
+                    ci++;
+                    if (ci < cs)
+                        try { count = stoi(commandargs[ci++]); }
+                    catch (...) {}
+                    evalspeedtest(count);
+                    break;
+                }
                 if (ci < cs)
                     try { threads = stoi(commandargs[ci++]); }
                 catch (...) {}
@@ -709,6 +791,9 @@ void engine::communicate(string inputstring)
                 speedtest(threads, hash, time);
                 break;
             }
+            case EVALBENCH:
+                evalbench(ci < cs ? commandargs[ci] : "");
+                break;
 #ifdef NNUELEARN
             case GENSFEN:
                 gensfen(commandargs);
@@ -738,6 +823,25 @@ void engine::communicate(string inputstring)
                 statistics.output(commandargs);
                 break;
 #endif
+            case TT:
+                // tt stats [reset]: fill/age/depth distribution of the table and (with STATISTICS) usage counters of the threads
+                if (ci < cs && commandargs[ci++] == "stats")
+                {
+                    ttstatistic* counters = nullptr;
+#ifdef STATISTICS
+                    bool reset = (ci < cs && commandargs[ci] == "reset");
+                    ttstatistic merged = {};
+                    for (int i = 0; i < Threads; i++)
+                    {
+                        merged.merge(&sthread[i].pos->ttstats);
+                        if (reset)
+                            memset(&sthread[i].pos->ttstats, 0, sizeof(ttstatistic));
+                    }
+                    counters = &merged;
+#endif
+                    tp.printStatistics(counters);
+                }
+                break;
             default:
 #ifdef SEARCHOPTIONS
                 // Try to consume output of SPSA tune "name, value"
@@ -758,6 +862,7 @@ void engine::communicate(string inputstring)
     } while (command != QUIT && (inputstring == "" || pendingposition));
     if (command == QUIT) {
         searchWaitStop();
+        uciSaveHash();
 #ifdef STATISTICS
         // Output of statistics data before exit (e.g. when palying in a GUI)
         if (!statistics.outputDone)
@@ -892,9 +997,12 @@ void engine::startSearchTime(bool ponderhit)
 void prepareSearch(chessposition* pos, chessposition* rootpos)
 {
     // copy essential board data from rootpos to thread's position
-    // cout << offsetof(chessposition, history) << "\n";
-    memcpy((void*)pos, rootpos, offsetof(chessposition, history));
+    // cout << offsetof(chessposition, hst) << "\n";
+    memcpy((void*)pos, rootpos, offsetof(chessposition, hst));
     // reset of several variables that are not clean in rootpos
+    pos->killer[0][0] = pos->killer[0][1] = 0;
+    pos->bestFailingLow = 0;
+    pos->failhighcount[0] = pos->failhighcount[1] = 0;
     pos->bestmovescore[0] = NOSCORE;
     pos->bestmove = 0;
     pos->pondermove = 0;
@@ -909,6 +1017,10 @@ void prepareSearch(chessposition* pos, chessposition* rootpos)
     int startIndex = PREROOTMOVES - framesToCopy + 1;
     memcpy(&pos->prerootmovestack[startIndex], &rootpos->prerootmovestack[startIndex], framesToCopy * sizeof(chessmovestack));
     memcpy(&pos->prerootmovecode[startIndex], &rootpos->prerootmovecode[startIndex], framesToCopy * sizeof(uint32_t));
+#ifdef COPYMAKE
+    // the board stack is behind the copied block; save the root board for unplayMove at ply 0
+    pos->prepareStack();
+#endif
 
     if (NnueCurrentArch)
         NnueCurrentArch->ResetAccumulationCache(pos);
@@ -918,8 +1030,11 @@ void prepareSearch(chessposition* pos, chessposition* rootpos)
 // Preparation for search thread's position without rootpos
 void prepareSearch(chessposition* pos)
 {
-    memset((void*)pos, 0, offsetof(chessposition, history));
+    memset((void*)pos, 0, offsetof(chessposition, hst));
 
+    pos->killer[0][0] = pos->killer[0][1] = 0;
+    pos->bestFailingLow = 0;
+    pos->failhighcount[0] = pos->failhighcount[1] = 0;
     pos->bestmovescore[0] = NOSCORE;
     pos->bestmove = 0;
     pos->pondermove = 0;
@@ -963,7 +1078,7 @@ void engine::searchStart()
     tp.nextSearch();
     rootposition.preparePosition();
     // init nodespermove for main thread
-    memset(&sthread[0].pos->nodespermove, 0, sizeof(chessposition::nodespermove));    
+    memset(&sthread[0].pos->sst->nodespermove, 0, sizeof(searchstack::nodespermove));    
     for (int tnum = 0; tnum < Threads; tnum++) {
         chessposition* pos = sthread[tnum].pos;
         pos->threadindex = tnum;   // signal that the thread is (will be) alive
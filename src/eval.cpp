@@ -296,21 +296,6 @@ void traceEvalOut()
     
 }
 
-#if 0  // this could be useful if endgames are preregistered
-void register_endgame(string gamesignature, int(*endgame)(chessposition*))
-{
-    int pcs[16];
-    getPcsFromStr(gamesignature.c_str(), pcs);
-    for (int col = WHITE; col <= BLACK; col++)
-    {
-        U64 mathash = calc_key_from_pcs(pcs, col);
-        Materialhashentry* e;
-        mh.probeHash(mathash, &e);
-    }
-}
-#endif
-
-
 // some common endgames that need help of special evaluation
 inline int KBNvK(chessposition *p)
 {
@@ -743,8 +728,8 @@ int chessposition::getGeneralEval(positioneval *pe)
     pe->kingattackers[Me] = POPCOUNT(attackedBy[Me][PAWN] & kingdangerMask[kingpos[You]][You]);
 
     // bonus for double bishop
-    int result = EVAL(eps.eDoublebishopbonus, S2MSIGN(Me) * (POPCOUNT(piece00[WBISHOP | Me]) >= 2));
-    if (bTrace) te.minors[Me] += EVAL(eps.eDoublebishopbonus, S2MSIGN(Me) * (POPCOUNT(piece00[WBISHOP | Me]) >= 2));
+    int result = pe->mhentry->bishoppair[Me];
+    if (bTrace) te.minors[Me] += pe->mhentry->bishoppair[Me];
 
     // bonus for rook on 7th pressing against the king
     if ((piece00[WROOK | Me] & RANK7(Me)) && (piece00[WKING | You] & (RANK7(Me) | RANK8(Me))))
@@ -799,9 +784,41 @@ constexpr U64 MH_Kkbpp = 0xF843081EE1F63B4D;
 constexpr U64 MH_KBNk = 0xDBD938988C07BA2B;
 constexpr U64 MH_Kkbn = 0xCD42B1F2ACF170CF;
 
-inline bool chessposition::isEndgame(int *score)
+// Special evaluations of known endgames
+static bool drawnEndgame(chessposition *p, int *score)
+{
+    (void)p;
+    (void)score;
+    return true;
+}
+
+static bool KBPvKEndgame(chessposition *p, int *score)
+{
+    (void)score;
+    // Wrong bishop and rook pawn(s) with the defending king in the corner
+    if (p->piece00[WBISHOP] & WHITEBB)
+        return !(p->piece00[WPAWN] & ~FILEHBB) && squareDistance[p->kingpos[BLACK]][63] <= 0;
+    else
+        return !(p->piece00[WPAWN] & ~FILEABB) && squareDistance[p->kingpos[BLACK]][56] <= 0;
+}
+
+static bool KvKBPEndgame(chessposition *p, int *score)
+{
+    (void)score;
+    if (p->piece00[BBISHOP] & WHITEBB)
+        return !(p->piece00[BPAWN] & ~FILEABB) && squareDistance[p->kingpos[WHITE]][0] <= 0;
+    else
+        return !(p->piece00[BPAWN] & ~FILEHBB) && squareDistance[p->kingpos[WHITE]][7] <= 0;
+}
+
+static bool KBNvKEndgame(chessposition *p, int *score)
+{
+    *score = KBNvK(p);
+    return true;
+}
+
+static endgamefunc getEndgameFunction(U64 materialhash)
 {
-    U64 materialhash = zb.getMaterialHash(this);
     switch(materialhash) {
     case MH_Kk:
     case MH_KNk:
@@ -814,25 +831,18 @@ inline bool chessposition::isEndgame(int *score)
     case MH_KBkb:
     case MH_KNkb:
     case MH_KBkn:
-        return true;
+        return drawnEndgame;
     case MH_KBPk:
     case MH_KBPPk:
-        if (piece00[WBISHOP] & WHITEBB)
-            return !(piece00[WPAWN] & ~FILEHBB) && squareDistance[kingpos[BLACK]][63] <= 0;
-        else
-            return !(piece00[WPAWN] & ~FILEABB) && squareDistance[kingpos[BLACK]][56] <= 0;
+        return KBPvKEndgame;
     case MH_Kkbp:
     case MH_Kkbpp:
-        if (piece00[BBISHOP] & WHITEBB)
-            return !(piece00[BPAWN] & ~FILEABB) && squareDistance[kingpos[WHITE]][0] <= 0;
-        else
-            return !(piece00[BPAWN] & ~FILEHBB) && squareDistance[kingpos[WHITE]][7] <= 0;
+        return KvKBPEndgame;
     case MH_KBNk:
     case MH_Kkbn:
-        *score = KBNvK(this);
-        return true;
+        return KBNvKEndgame;
     default:
-        return false;
+        return nullptr;
     }
 }
 
@@ -851,9 +861,15 @@ int chessposition::getEval()
 #endif
 
     int score = SCOREDRAW;
+    positioneval pe;
+    pe.mhentry = nullptr;
 
-    if (piececount <= 5 && isEndgame(&score))
-        return S2MSIGN(state & S2MMASK) * score;
+    if (piececount <= 5)
+    {
+        pe.mhentry = mtrlhsh.probeHash(this);
+        if (pe.mhentry->endgame && pe.mhentry->endgame(this, &score))
+            return S2MSIGN(state & S2MMASK) * score;
+    }
 
     if (NnueReady && abs(GETEGVAL(psqval)) < NnuePsqThreshold)
     {
@@ -877,8 +893,21 @@ int chessposition::getEval()
     // reset the attackedBy information
     memset(attackedBy, 0, sizeof(attackedBy));
 
-    positioneval pe;
-    bool hashexist = pwnhsh.probeHash(zb.getPawnKingHash(this), &pe.phentry);
+    if (!pe.mhentry)
+        pe.mhentry = mtrlhsh.probeHash(this);
+    pawnhashentry sharedentry;
+    const U64 pawnkinghash = zb.getPawnKingHash(this);
+    bool hashexist;
+    if (sharedpwnhsh.table)
+    {
+        // work on a private copy of the shared entry
+        pe.phentry = &sharedentry;
+        hashexist = sharedpwnhsh.probeHash(pawnkinghash, pe.phentry);
+    }
+    else
+    {
+        hashexist = pwnhsh.probeHash(pawnkinghash, &pe.phentry);
+    }
     if (bTrace || !hashexist)
     {
         if (bTrace) pe.phentry->value = 0;
@@ -886,6 +915,8 @@ int chessposition::getEval()
         getPawnAndKingEval<Et, 1>(pe.phentry);
         U64 pawns = piece00[WPAWN] | piece00[BPAWN];
         pe.phentry->bothFlanks = ((pawns & FLANKLEFT) && (pawns & FLANKRIGHT));
+        if (sharedpwnhsh.table)
+            sharedpwnhsh.addHash(pawnkinghash, pe.phentry);
     }
 
     int pawnEval = pe.phentry->value;
@@ -899,7 +930,7 @@ int chessposition::getEval()
     int totalEval = psqval + pawnEval + generalEval + piecesEval + lateEval;
 
     int sideToScale = GETEGVAL(totalEval) > SCOREDRAW ? WHITE : BLACK;
-    sc = getScaling(sideToScale);
+    sc = getScaling(pe.mhentry, sideToScale);
     if (!bTrace && sc == SCALE_DRAW)
         return SCOREDRAW;
 
@@ -912,13 +943,13 @@ int chessposition::getEval()
         te.complexity[complexity < 0] += complexity;
     }
 
-    score = TAPEREDANDSCALEDEVAL(totalEval, getPhase(), sc) + CEVAL(eps.eTempo, S2MSIGN(state & S2MMASK));
+    score = TAPEREDANDSCALEDEVAL(totalEval, pe.mhentry->phase, sc) + CEVAL(eps.eTempo, S2MSIGN(state & S2MMASK));
 
     if (bTrace)
     {
         getpsqval(en.evaldetails);
         te.sc = sc;
-        te.ph = getPhase();
+        te.ph = pe.mhentry->phase;
         te.total = totalEval;
         te.score = score;
         traceEvalOut();
@@ -942,7 +973,7 @@ int chessposition::getComplexity(int val, pawnhashentry *phentry)
 }
 
 
-int chessposition::getScaling(int me)
+void chessposition::getMaterialInfo(materialhashentry *entry)
 {
     // Calculate scaling for endgames with special material
     const int pawns[2] = { POPCOUNT(piece00[WPAWN]), POPCOUNT(piece00[BPAWN]) };
@@ -961,26 +992,42 @@ int chessposition::getScaling(int me)
         + queens[BLACK] * materialvalue[QUEEN]
     };
 
-    // Default scaling
-    int scale = SCALE_NORMAL;
+    for (int me = WHITE; me <= BLACK; me++)
+    {
+        // Default scaling
+        int scale = SCALE_NORMAL;
+
+        // Check for insufficient material using simnple heuristic from chessprogramming site
+        int you = me ^ S2MMASK;
 
-    // Check for insufficient material using simnple heuristic from chessprogramming site
-    int you = me ^ S2MMASK;
+        if (pawns[me] == 0 && nonpawnvalue[me] - nonpawnvalue[you] <= materialvalue[BISHOP])
+            scale = nonpawnvalue[me] < materialvalue[ROOK] ? SCALE_DRAW : SCALE_HARDTOWIN;
 
-    if (pawns[me] == 0 && nonpawnvalue[me] - nonpawnvalue[you] <= materialvalue[BISHOP])
-        scale = nonpawnvalue[me] < materialvalue[ROOK] ? SCALE_DRAW : SCALE_HARDTOWIN;
+        if (pawns[me] == 1 && nonpawnvalue[me] - nonpawnvalue[you] <= materialvalue[BISHOP])
+            scale = SCALE_ONEPAWN;
 
-    if (pawns[me] == 1 && nonpawnvalue[me] - nonpawnvalue[you] <= materialvalue[BISHOP])
-        scale = SCALE_ONEPAWN;
+        entry->scale[me] = (uint8_t)scale;
+        entry->bishoppair[me] = EVAL(eps.eDoublebishopbonus, S2MSIGN(me) * (bishops[me] >= 2));
+    }
 
-    U64 bishopsbb = (piece00[WBISHOP] | piece00[BBISHOP]);
-    if (bishops[WHITE] == 1 && bishops[BLACK] == 1
-        && (bishopsbb & WHITEBB) && (bishopsbb & BLACKBB)
+    entry->ocbCandidate = (bishops[WHITE] == 1 && bishops[BLACK] == 1
         && nonpawnvalue[WHITE] <= materialvalue[BISHOP]
-        && nonpawnvalue[BLACK] <= materialvalue[BISHOP])
-        scale = SCALE_OCB;
+        && nonpawnvalue[BLACK] <= materialvalue[BISHOP]);
+    entry->phase = (int16_t)getPhase();
+    entry->endgame = (piececount <= 5 ? getEndgameFunction(zb.getMaterialHash(this)) : nullptr);
+}
+
+
+int chessposition::getScaling(materialhashentry *entry, int me)
+{
+    if (entry->ocbCandidate)
+    {
+        U64 bishopsbb = (piece00[WBISHOP] | piece00[BBISHOP]);
+        if ((bishopsbb & WHITEBB) && (bishopsbb & BLACKBB))
+            return SCALE_OCB;
+    }
 
-    return scale;
+    return entry->scale[me];
 }
 
 // Explicit template instantiation
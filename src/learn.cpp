@@ -1097,7 +1097,7 @@ static void gensfenthread(workingthread* thr)
             pos->toSfen(&thr->psv->sfen);
             thr->psv->score = score;
             thr->psv->gamePly = ply;
-            thr->psv->move = sfFromRubi(pos->pvtable[0][0]);
+            thr->psv->move = sfFromRubi(pos->sst->pvtable[0][0]);
             thr->psv->game_result = 2 * S2MSIGN(pos->state & S2MMASK); // not yet known
             thr->psv->padding = 0xff;
 
@@ -1122,7 +1122,7 @@ static void gensfenthread(workingthread* thr)
 
 SKIP_SAVE:
             // preset move for next ply with the pv move
-            nmc = pos->pvtable[0][0];
+            nmc = pos->sst->pvtable[0][0];
             if (!nmc)
             {
                 // No move in pv => mate or stalemate
@@ -1158,7 +1158,7 @@ SKIP_SAVE:
                         while (cur_multi_pv_diff && pos->bestmovescore[0] > pos->bestmovescore[s - 1] + cur_multi_pv_diff)
                             s--;
 
-                        nmc = pos->multipvtable[ranval(&rnd) % s][0];
+                        nmc = pos->sst->multipvtable[ranval(&rnd) % s][0];
                     }
                 }
 
@@ -1437,8 +1437,9 @@ sfenreader::sfenreader()
     int rookfiles[2][2] = { { 0 , 7 }, {0 , 7} };
     int kingfile[2] = { 4, 4 };
     memset((void*)&inbp, 0, sizeof(inbp));
-    pos = (chessposition*)allocalign64(sizeof(chessposition));
+    pos = new(allocalign64(sizeof(chessposition))) chessposition;
     pos->pwnhsh.setSize();
+    pos->mtrlhsh.setSize();
     pos->initCastleRights(rookfiles, kingfile);
     pos->accumulation = NnueCurrentArch ? NnueCurrentArch->CreateAccumulationStack() : nullptr;
     pos->psqtAccumulation = NnueCurrentArch ? NnueCurrentArch->CreatePsqtAccumulationStack() : nullptr;
@@ -1458,7 +1459,9 @@ sfenreader::sfenreader()
 sfenreader::~sfenreader()
 {
     pos->pwnhsh.remove();
+    pos->mtrlhsh.remove();
     freealigned64(inbuffer);
+    pos->~chessposition();
     freealigned64(pos);
 }
 
@@ -1753,7 +1756,7 @@ static void convertthread(workingthread* thr)
                 }
                 if (!outpos)
                 {
-                    outpos = outbp.outpos = (chessposition*)allocalign64(sizeof(chessposition));
+                    outpos = outbp.outpos = new(allocalign64(sizeof(chessposition))) chessposition;
                     inpos->copyToLight(outpos);
                     memcpy(outbp.outpos->castlerights, inpos->castlerights, sizeof(inpos->castlerights));
                 }
@@ -1820,8 +1823,10 @@ static void convertthread(workingthread* thr)
         delete cmpreader;
     if (outbuffer)
         freealigned64(outbuffer);
-    if (outpos)
+    if (outpos) {
+        outpos->~chessposition();
         freealigned64(outpos);
+    }
 
     thr->index = -1;
 }
@@ -21,12 +21,40 @@
 using namespace rubichess;
 
 
+#ifdef DISPATCHARCH
+// The Makefile moves the static initializers of every arch to section dispatchinit_<arch>
+// so only the arch selected by the dispatcher initializes its globals
+#define DISPATCHINIT2(s, a) s ## a
+#define DISPATCHINIT(s, a) DISPATCHINIT2(s, a)
+extern "C" void (*DISPATCHINIT(__start_dispatchinit_, DISPATCHARCH)[])();
+extern "C" void (*DISPATCHINIT(__stop_dispatchinit_, DISPATCHARCH)[])();
+
+static int engineMain(int argc, char* argv[]);
+
+U64 rubichess::dispatchedBinarySupports()
+{
+    return compilerinfo::binarySupports;
+}
+
+int rubichess::dispatchedMain(int argc, char* argv[])
+{
+    for (auto init = DISPATCHINIT(__start_dispatchinit_, DISPATCHARCH); init < DISPATCHINIT(__stop_dispatchinit_, DISPATCHARCH); init++)
+        (*init)();
+
+    return engineMain(argc, argv);
+}
+
+static int engineMain(int argc, char* argv[])
+#else
 int main(int argc, char* argv[])
+#endif
 {
     int startnum;
     int perfmaxdepth;
+    bool fastperft;
     bool verbose;
     bool benchmark;
+    bool evalbenchmark;
     bool openbench;
     int depth;
     bool enginetest;
@@ -50,9 +78,11 @@ int main(int argc, char* argv[])
         { "-bench", "Do benchmark test for some positions.", &benchmark, 0, NULL },
         { "bench", "Do benchmark with OpenBench compatible output.", &openbench, 0, NULL },
         { "-depth", "Depth for benchmark (0 for per-position-default)", &depth, 1, "0" },
+        { "-evalbench", "Time the NNUE kernels on the speedtest positions or an epd file (use with -epdfile)", &evalbenchmark, 0, NULL },
         { "-perft", "Do performance and move generator testing.", &perfmaxdepth, 1, "0" },
+        { "-fastperft", "Use bulk counting, perft hash and a split job queue (use with -perft)", &fastperft, 0, NULL },
         { "-enginetest", "bulk testing of epd files", &enginetest, 0, NULL },
-        { "-epdfile", "the epd file to test (use with -enginetest or -bench)", &epdfile, 2, "" },
+        { "-epdfile", "the epd file to test (use with -enginetest, -bench or -evalbench)", &epdfile, 2, "" },
         { "-logfile", "output file (use with -enginetest)", &logfile, 2, "enginetest.log" },
         { "-engineprg", "the uci engine to test (use with -enginetest)", &engineprg, 2, "" },
         { "-maxtime", "time for each test in seconds (use with -enginetest or -bench)", &maxtime, 1, "0" },
@@ -183,7 +213,7 @@ int main(int argc, char* argv[])
     if (perfmaxdepth)
     {
         // do a perft test
-        perftest(perfmaxdepth);
+        perftest(perfmaxdepth, fastperft);
     } else if (benchmark || openbench)
     {
         en.bench(depth, epdfile, maxtime, startnum, openbench);
@@ -195,6 +225,9 @@ int main(int argc, char* argv[])
             if (NnueReady || oldNnueReady)
                 en.bench(depth, epdfile, maxtime, startnum, openbench);
         }
+    } else if (evalbenchmark)
+    {
+        evalbench(epdfile);
     } else if (enginetest)
     {
 #ifdef _WIN32
@@ -85,23 +85,20 @@ void chessmovelist::print()
     printf("%s", toString().c_str());
 }
 
-// Sorting for MoveSelector; keep the move in the list
-chessmove* chessmovelist::getNextMove(int minval)
+// Sorting for MoveSelector; stable insertion sort by descending value so the selector can just walk the list
+void chessmovelist::sortByValue()
 {
-    int current = -1;
-    for (int i = 0; i < length; i++)
+    for (int i = 1; i < length; i++)
     {
-        if (move[i].value > minval)
+        chessmove m = move[i];
+        int j = i - 1;
+        while (j >= 0 && move[j].value < m.value)
         {
-            minval = move[i].value;
-            current = i;
+            move[j + 1] = move[j];
+            j--;
         }
+        move[j + 1] = m;
     }
-
-    if (current >= 0)
-        return &move[current];
-
-    return nullptr;
 }
 
 // Sorting for MoveSelector; remove it from the list
@@ -190,12 +187,12 @@ void chessposition::evaluateMoves(chessmovelist *ml)
         if (Mt == CAPTURE || (Mt == ALL && GETCAPTURE(mc)))
         {
             PieceCode capture = GETCAPTURE(mc);
-            ml->move[i].value = (mvv[capture >> 1] | lva[piece >> 1]) + tacticalhst[piece >> 1][GETTO(mc)][capture >> 1];
+            ml->move[i].value = (mvv[capture >> 1] | lva[piece >> 1]) + hst->tacticalhst[piece >> 1][GETTO(mc)][capture >> 1];
         }
         if (Mt == QUIET || (Mt == ALL && !GETCAPTURE(mc)))
         {
             int to = GETCORRECTTO(mc);
-            ml->move[i].value = history[piece & S2MMASK][threatSquare][GETFROM(mc)][to];
+            ml->move[i].value = hst->history[piece & S2MMASK][threatSquare][GETFROM(mc)][to];
             int pieceTo = piece * 64 + to;
             ml->move[i].value += (conthistptr[ply - 1][pieceTo] + conthistptr[ply - 2][pieceTo] + (conthistptr[ply - 4][pieceTo] + conthistptr[ply - 6][pieceTo]) / 2);
         }
@@ -228,7 +225,8 @@ void chessposition::preparePosition()
     bool bImmediate3fold = false;
 
     bool tthit;
-    ttentry* tte = tp.probeHash(hash, &tthit);
+    ttentry tte;
+    ttslot tts = tp.probeHash(hash, &tthit, &tte);
     bool bSearchmoves = (en.searchmoves.size() > 0);
 
     excludemovestack[0] = 0; // FIXME: Not very nice; is it worth to do do singular testing in root search?
@@ -254,7 +252,7 @@ void chessposition::preparePosition()
                     bImmediate3fold = true;
                     moveTo3fold = m->code;
                 }
-                else if ((uint16_t)m->code == tte->movecode)
+                else if ((uint16_t)m->code == tte.movecode)
                 {
                     // Test if this move makes a 3fold possible for opponent
                     prepareStack();
@@ -285,7 +283,7 @@ void chessposition::preparePosition()
     }
     if (moveTo3fold)
         // Hashmove triggers 3fold immediately or with following move; fix hash
-        tp.addHash(tte, hash, SCOREDRAW, tte->staticeval, bImmediate3fold ? HASHBETA : HASHALPHA, 250 + TTDEPTH_OFFSET, moveTo3fold);
+        tp.addHash(tts, hash, SCOREDRAW, tte.staticeval, bImmediate3fold ? HASHBETA : HASHALPHA, 250 + TTDEPTH_OFFSET, moveTo3fold);
 
     tbPosition = 0;
     useRootmoveScore = 0;
@@ -511,10 +509,41 @@ bool chessposition::moveGivesCheck(uint32_t c)
 }
 
 
+// Test a pseudo-legal move for legality without playing it; needs kingPinned updated by a non-lite playMove
+// Evasions, castles and ep captures are rare and still tested by playing the move
+bool chessposition::moveIsLegal(uint32_t c)
+{
+    int me = state & S2MMASK;
+
+    if (isCheckbb || ISEPCAPTUREORCASTLE(c))
+    {
+        if (!playMove<true>(c))
+            return false;
+        unplayMove<true>(c);
+        return true;
+    }
+
+    int from = GETFROM(c);
+    int to = GETTO(c);
+    int king = kingpos[me];
+
+    if (from == king)
+        return !isAttacked(to, me);
+
+    if (!(kingPinned & BITSET(from))
+        || (betweenMask[king][to] & BITSET(from)) || (betweenMask[king][from] & BITSET(to)))
+        return true;
+
+    // (potentially) pinned piece leaves the ray of its king
+    U64 occ = ((occupied00[0] | occupied00[1]) ^ BITSET(from)) | BITSET(to);
+    return !(isAttackedByMySlider(king, occ, me ^ S2MMASK) & ~BITSET(to));
+}
+
+
 void chessposition::playNullMove()
 {
     lastnullmove = ply;
-    conthistptr[ply] = (int16_t*)counterhistory[0][0];
+    conthistptr[ply] = (int16_t*)hst->counterhistory[0][0];
     movecode[ply++] = 0;
     state ^= S2MMASK;
     hash ^= zb.s2m ^ zb.ept[ept];
@@ -717,6 +746,9 @@ bool chessposition::playMove(uint32_t mc)
             }
             halfmovescounter = movestack[ply].halfmovescounter;
             kingpos[s2m] = movestack[ply].kingpos[s2m];
+#ifdef COPYMAKE
+            memcpy(&materialkey, &boardstack[ply], sizeof(chessboardstack));
+#else
             mailbox[from] = pfrom;
             if (promote != BLANK)
             {
@@ -748,6 +780,7 @@ bool chessposition::playMove(uint32_t mc)
             else {
                 mailbox[to] = BLANK;
             }
+#endif
             return false;
         }
 
@@ -778,8 +811,17 @@ bool chessposition::playMove(uint32_t mc)
         hash ^= zb.cstl[oldcastle];
 
         PREFETCH(&tp.table[hash & tp.sizemask]);
+        if (!NnueReady)
+        {
+            // classical evaluation will need the pawn hash entry
+            U64 pawnkinghash = zb.getPawnKingHash(this);
+            if (sharedpwnhsh.table)
+                PREFETCH(&sharedpwnhsh.table[pawnkinghash & sharedpwnhsh.sizemask]);
+            else
+                PREFETCH(&pwnhsh.table[pawnkinghash & pwnhsh.sizemask]);
+        }
 
-        conthistptr[ply] = (int16_t*)counterhistory[GETPIECE(mc)][GETCORRECTTO(mc)];
+        conthistptr[ply] = (int16_t*)hst->counterhistory[GETPIECE(mc)][GETCORRECTTO(mc)];
         myassert(piececount == POPCOUNT(occupied00[WHITE] | occupied00[BLACK]), this, 1, piececount);
     }
     movecode[ply++] = mc;
@@ -790,6 +832,8 @@ bool chessposition::playMove(uint32_t mc)
         updatePins<WHITE>();
         updatePins<BLACK>();
         nodes++;
+        if (NnueReady)
+            NnueCurrentArch->PrefetchFeatureWeights(this);
     }
 
     return true;
@@ -806,6 +850,11 @@ void chessposition::unplayMove(uint32_t mc)
     if (!LiteMode && (state & S2MMASK))
         fullmovescounter--;
 
+#ifdef COPYMAKE
+    // restore the board saved in prepareStack()
+    memcpy(&materialkey, &boardstack[ply], sizeof(chessboardstack));
+    (void)mc;
+#else
     // Castle has special undo
     if (ISCASTLE(mc))
     {
@@ -871,6 +920,7 @@ void chessposition::unplayMove(uint32_t mc)
             mailbox[to] = BLANK;
         }
     }
+#endif
 }
 
 
@@ -894,8 +944,8 @@ void MoveSelector::SetPreferredMoves(chessposition *p)
         margin = 0;
     }
     hashmove = 0;   // FIXME: maybe worth to give a hashmove here?
-    captures = &pos->captureslist[pos->ply];
-    quiets = &pos->quietslist[pos->ply];
+    captures = &pos->sst->captureslist[pos->ply];
+    quiets = &pos->sst->quietslist[pos->ply];
 }
 
 // Constructor for probcut
@@ -907,9 +957,9 @@ void MoveSelector::SetPreferredMoves(chessposition* p, int m, int excludemove)
     hashmove = 0;
     state = TACTICALINITSTATE;
     if (!excludemove)
-        captures = &pos->captureslist[pos->ply];
+        captures = &pos->sst->captureslist[pos->ply];
     else
-        captures = &pos->singularcaptureslist[pos->ply];
+        captures = &pos->sst->singularcaptureslist[pos->ply];
 }
 
 // Constructor for alphabeta search
@@ -917,18 +967,19 @@ void MoveSelector::SetPreferredMoves(chessposition *p, uint16_t hshm, uint32_t k
 {
     pos = p;
     hashmove = p->shortMove2FullMove(hshm);
+    STATISTICSDO(if (hshm && !hashmove) TTSTATISTICSINC(collisions));
     killermove1 = (kllm1 != hashmove ? kllm1 : 0);
     killermove2 = (kllm2 != hashmove ? kllm2 : 0);
     countermove = (counter != hashmove && counter != kllm1 && counter != kllm2 ? counter : 0);
     if (!excludemove)
     {
-        captures = &pos->captureslist[pos->ply];
-        quiets = &pos->quietslist[pos->ply];
+        captures = &pos->sst->captureslist[pos->ply];
+        quiets = &pos->sst->quietslist[pos->ply];
     }
     else
     {
-        captures = &pos->singularcaptureslist[pos->ply];
-        quiets = &pos->singularquietslist[pos->ply];
+        captures = &pos->sst->singularcaptureslist[pos->ply];
+        quiets = &pos->sst->singularquietslist[pos->ply];
     }
     state = (p->isCheckbb ? EVASIONINITSTATE : HASHMOVESTATE);
     onlyGoodCaptures = false;
@@ -955,12 +1006,16 @@ uint32_t MoveSelector::next()
         STATISTICSDO(numOfCaptures = captures->length);
         STATISTICSDO(if (numOfCaptures) statistics.ms_tactic_stage[PvNode][depth][numOfCaptures]++ && statistics.ms_tactic_stage[PvNode][depth][0]++);
         pos->evaluateMoves<CAPTURE>(captures);
+        captures->sortByValue();
+        tacticalindex = badtacticalindex = 0;
+        seeAttackers.num = 0;
         // fall through
     case TACTICALSTATE:
-        while ((m = captures->getNextMove(0)))
+        while (tacticalindex < captures->length && captures->move[tacticalindex].value > 0)
         {
+            m = &captures->move[tacticalindex++];
             SDEBUGDO(true, value = m->value;)
-            if (!pos->see(m->code, margin))
+            if (!pos->seeCached(m->code, margin, seeAttackers))
             {
                 m->value |= BADTACTICALFLAG;
             }
@@ -1031,12 +1086,12 @@ uint32_t MoveSelector::next()
         state++;
         // fall through
     case BADTACTICALSTATE:
-        while ((m = captures->getNextMove()))
+        while (badtacticalindex < captures->length)
         {
+            m = &captures->move[badtacticalindex++];
             SDEBUGDO(true, value = m->value;)
-            bool bBadTactical = (m->value & BADTACTICALFLAG);
-            m->value = INT_MIN;
-            if (bBadTactical) {
+            // good captures were already returned and marked with INT_MIN
+            if (m->value != INT_MIN && (m->value & BADTACTICALFLAG)) {
                 STATISTICSDO(if (m->code == hashmove) STATISTICSINC(moves_bad_hash));
                 STATISTICSINC(ms_badtactic_moves[PvNode][depth]);
                 return m->code;
@@ -1086,7 +1141,7 @@ inline void appendPromotionMove(chessmove **m, int from, int to, int col, PieceT
 }
 
 
-template <PieceType Pt, Color me> int chessposition::CreateMovelistPiece(chessmove* mstart, U64 occ, U64 targets)
+template <PieceType Pt, Color me, bool Legal> int chessposition::CreateMovelistPiece(chessmove* mstart, U64 occ, U64 targets, U64 pinned)
 {
     const PieceCode pc = (PieceCode)((Pt << 1) | me);
     U64 frombits = piece00[pc];
@@ -1104,9 +1159,14 @@ template <PieceType Pt, Color me> int chessposition::CreateMovelistPiece(chessmo
             tobits |= (ROOKATTACKS(occ, from) & targets);
         if (Pt == KING)
             tobits = (king_attacks[from] & targets);
+        if (Legal && Pt != KING && (pinned & BITSET(from)))
+            // pinned piece can only move on the line to its king
+            tobits &= lineMask[kingpos[me]][from];
         while (tobits)
         {
             int to = pullLsb(&tobits);
+            if (Legal && Pt == KING && isAttacked(to, me))
+                continue;
             appendMoveToList(&m, from, to, pc, mailbox[to]);
         }
     }
@@ -1154,12 +1214,13 @@ template <Color me> inline int chessposition::CreateMovelistCastle(chessmove* ms
 }
 
 
-template <MoveType Mt, Color me> inline int chessposition::CreateMovelistPawn(chessmove* mstart)
+template <MoveType Mt, Color me> inline int chessposition::CreateMovelistPawn(chessmove* mstart, U64 pinned)
 {
     chessmove *m = mstart;
     const int you = 1 - me;
     const PieceCode pc = (PieceCode)(WPAWN | me);
     const U64 occ = occupied00[0] | occupied00[1];
+    const U64* pinline = lineMask[kingpos[me]];
     U64 frombits, tobits;
     int from, to;
 
@@ -1168,6 +1229,12 @@ template <MoveType Mt, Color me> inline int chessposition::CreateMovelistPawn(ch
         U64 push = PAWNPUSH(you, ~occ & ~PROMOTERANKBB);
         U64 pushers = push & piece00[pc];
         U64 doublepushers = PAWNPUSH(you, push) & (RANK2(me) & pushers);
+        if (Mt & LEGAL)
+        {
+            // pinned pawns can only push on the file of their king
+            pushers &= ~pinned | fileMask[kingpos[me]];
+            doublepushers &= ~pinned | fileMask[kingpos[me]];
+        }
         while (pushers)
         {
             from = pullLsb(&pushers);
@@ -1191,6 +1258,8 @@ template <MoveType Mt, Color me> inline int chessposition::CreateMovelistPawn(ch
         {
             from = pullLsb(&frombits);
             tobits = (pawn_attacks_to[from][me] & occupied00[you]);
+            if ((Mt & LEGAL) && (pinned & BITSET(from)))
+                tobits &= pinline[from];
             while (tobits)
             {
                 to = pullLsb(&tobits);
@@ -1203,6 +1272,8 @@ template <MoveType Mt, Color me> inline int chessposition::CreateMovelistPawn(ch
             while (frombits)
             {
                 from = pullLsb(&frombits);
+                if ((Mt & LEGAL) && !epCaptureIsLegal(from))
+                    continue;
                 appendMoveToList(&m, from, ept, pc, WPAWN | you);
                 (m - 1)->code |= EPCAPTUREFLAG;
             }
@@ -1217,6 +1288,8 @@ template <MoveType Mt, Color me> inline int chessposition::CreateMovelistPawn(ch
         {
             from = pullLsb(&frombits);
             tobits = (pawn_attacks_to[from][me] & occupied00[you]) | (pawn_moves_to[from][me] & ~occ);
+            if ((Mt & LEGAL) && (pinned & BITSET(from)))
+                tobits &= pinline[from];
             while (tobits)
             {
                 to = pullLsb(&tobits);
@@ -1233,7 +1306,41 @@ template <MoveType Mt, Color me> inline int chessposition::CreateMovelistPawn(ch
 }
 
 
-int chessposition::CreateEvasionMovelist(chessmove* mstart)
+// Returns the pieces of side me that are pinned to their king; same as kingPinned but independent of the LiteMode of playMove
+U64 chessposition::pinnedPieces(int me)
+{
+    const int you = me ^ S2MMASK;
+    const int k = kingpos[me];
+    U64 occ = occupied00[you];
+    U64 pinned = 0ULL;
+    U64 attackers = ROOKATTACKS(occ, k) & (piece00[WROOK | you] | piece00[WQUEEN | you]);
+    attackers |= BISHOPATTACKS(occ, k) & (piece00[WBISHOP | you] | piece00[WQUEEN | you]);
+
+    while (attackers)
+    {
+        int index = pullLsb(&attackers);
+        U64 potentialPinners = betweenMask[index][k] & occupied00[me];
+        if (ONEORZERO(potentialPinners))
+            pinned |= potentialPinners;
+    }
+    return pinned;
+}
+
+
+// ep capture removes two pieces from the board and may uncover the king even on the rank, so test it with the new occupancy
+bool chessposition::epCaptureIsLegal(int from)
+{
+    const int me = state & S2MMASK;
+    const int you = me ^ S2MMASK;
+    const int epfield = (from & 0x38) | (ept & 0x07);
+    U64 occ = (occupied00[0] | occupied00[1]) ^ BITSET(from) ^ BITSET(epfield) ^ BITSET(ept);
+
+    return !isAttackedByMySlider(kingpos[me], occ, you)
+        && !(isCheckbb & (piece00[WKNIGHT | you] | piece00[WPAWN | you]) & ~BITSET(epfield));
+}
+
+
+template <bool Legal> int chessposition::CreateEvasionMovelist(chessmove* mstart)
 {
     chessmove* m = mstart;
     int me = state & S2MMASK;
@@ -1244,6 +1351,7 @@ int chessposition::CreateEvasionMovelist(chessmove* mstart)
     PieceCode pc;
     int king = kingpos[me];
     U64 occupiedbits = (occupied00[0] | occupied00[1]);
+    U64 pinned = (Legal ? pinnedPieces(me) : kingPinned);
 
     // moving the king is alway a possibe evasion
     targetbits = king_attacks[king] & ~occupied00[me];
@@ -1268,6 +1376,8 @@ int chessposition::CreateEvasionMovelist(chessmove* mstart)
             while (frombits)
             {
                 from = pullLsb(&frombits);
+                if (Legal && !epCaptureIsLegal(from))
+                    continue;
                 // treat ep capture as normal move and correct code manually
                 appendMoveToList(&m, from, attacker + S2MSIGN(me) * 8, WPAWN | me, WPAWN | you);
                 (m - 1)->code |= EPCAPTUREFLAG;
@@ -1280,7 +1390,7 @@ int chessposition::CreateEvasionMovelist(chessmove* mstart)
         targetbits = betweenMask[king][attacker];
         while (true)
         {
-            frombits = frombits & ~kingPinned;
+            frombits = frombits & ~pinned;
             while (frombits)
             {
                 from = pullLsb(&frombits);
@@ -1318,10 +1428,15 @@ int chessposition::CreateEvasionMovelist(chessmove* mstart)
 
 template <MoveType Mt> int chessposition::CreateMovelist(chessmove* mstart)
 {
+    const bool Legal = (Mt & LEGAL);
+    if (Legal && isCheckbb)
+        return CreateEvasionMovelist<true>(mstart);
+
     int me = state & S2MMASK;
     U64 occupiedbits = (occupied00[0] | occupied00[1]);
     U64 emptybits = ~occupiedbits;
     U64 targetbits = 0ULL;
+    U64 pinned = (Legal ? pinnedPieces(me) : 0ULL);
     chessmove* m = mstart;
 
     if (Mt & QUIET)
@@ -1330,22 +1445,22 @@ template <MoveType Mt> int chessposition::CreateMovelist(chessmove* mstart)
         targetbits |= occupied00[me ^ S2MMASK];
     if (me)
     {
-        m += CreateMovelistPawn<Mt, BLACK>(m);
-        m += CreateMovelistPiece<KNIGHT, BLACK>(m, occupiedbits, targetbits);
-        m += CreateMovelistPiece<BISHOP, BLACK>(m, occupiedbits, targetbits);
-        m += CreateMovelistPiece<ROOK, BLACK>(m, occupiedbits, targetbits);
-        m += CreateMovelistPiece<QUEEN, BLACK>(m, occupiedbits, targetbits);
-        m += CreateMovelistPiece<KING, BLACK>(m, occupiedbits, targetbits);
+        m += CreateMovelistPawn<Mt, BLACK>(m, pinned);
+        m += CreateMovelistPiece<KNIGHT, BLACK, Legal>(m, occupiedbits, targetbits, pinned);
+        m += CreateMovelistPiece<BISHOP, BLACK, Legal>(m, occupiedbits, targetbits, pinned);
+        m += CreateMovelistPiece<ROOK, BLACK, Legal>(m, occupiedbits, targetbits, pinned);
+        m += CreateMovelistPiece<QUEEN, BLACK, Legal>(m, occupiedbits, targetbits, pinned);
+        m += CreateMovelistPiece<KING, BLACK, Legal>(m, occupiedbits, targetbits, pinned);
         if (Mt & QUIET)
             m += CreateMovelistCastle<BLACK>(m);
     }
     else {
-        m += CreateMovelistPawn<Mt, WHITE>(m);
-        m += CreateMovelistPiece<KNIGHT, WHITE>(m, occupiedbits, targetbits);
-        m += CreateMovelistPiece<BISHOP, WHITE>(m, occupiedbits, targetbits);
-        m += CreateMovelistPiece<ROOK, WHITE>(m, occupiedbits, targetbits);
-        m += CreateMovelistPiece<QUEEN, WHITE>(m, occupiedbits, targetbits);
-        m += CreateMovelistPiece<KING, WHITE>(m, occupiedbits, targetbits);
+        m += CreateMovelistPawn<Mt, WHITE>(m, pinned);
+        m += CreateMovelistPiece<KNIGHT, WHITE, Legal>(m, occupiedbits, targetbits, pinned);
+        m += CreateMovelistPiece<BISHOP, WHITE, Legal>(m, occupiedbits, targetbits, pinned);
+        m += CreateMovelistPiece<ROOK, WHITE, Legal>(m, occupiedbits, targetbits, pinned);
+        m += CreateMovelistPiece<QUEEN, WHITE, Legal>(m, occupiedbits, targetbits, pinned);
+        m += CreateMovelistPiece<KING, WHITE, Legal>(m, occupiedbits, targetbits, pinned);
         if (Mt & QUIET)
             m += CreateMovelistCastle<WHITE>(m);
     }
@@ -1361,5 +1476,7 @@ template void chessposition::evaluateMoves<QUIET>(chessmovelist*);
 template void chessposition::evaluateMoves<CAPTURE>(chessmovelist*);
 template bool chessposition::playMove<true>(uint32_t);
 template void chessposition::unplayMove<true>(uint32_t);
+template int chessposition::CreateMovelist<LEGALALL>(chessmove*);
+template int chessposition::CreateEvasionMovelist<false>(chessmove*);
 
 } // namespace rubichess
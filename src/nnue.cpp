@@ -55,6 +55,16 @@ uint32_t PieceToIndex[2][16] = {
   { 0, 0, PS_BPAWN, PS_WPAWN, PS_BKNIGHT, PS_WKNIGHT, PS_BBISHOP, PS_WBISHOP, PS_BROOK, PS_WROOK, PS_BQUEEN, PS_WQUEEN, PS_KING, PS_KING, 0, 0 }
 };
 
+// mirror the files of a bitboard (a <-> h, b <-> g, ...)
+static inline U64 mirrorFiles(U64 bb)
+{
+    bb = ((bb >> 1) & 0x5555555555555555ULL) | ((bb & 0x5555555555555555ULL) << 1);
+    bb = ((bb >> 2) & 0x3333333333333333ULL) | ((bb & 0x3333333333333333ULL) << 2);
+    bb = ((bb >> 4) & 0x0f0f0f0f0f0f0f0fULL) | ((bb & 0x0f0f0f0f0f0f0f0fULL) << 4);
+    return bb;
+}
+
+
 // table for horizontal mirroring of king buckets
 static constexpr int KingBucket[64] = {
   -1, -1, -1, -1, 31, 30, 29, 28,
@@ -74,6 +84,29 @@ static constexpr int KingBucket[64] = {
 NnueType NnueReady = NnueDisabled;
 NnueArchitecture* NnueCurrentArch;
 
+
+// Update the accumulator like AccumulatorUpdate and time the refresh or incremental update
+// These change the state of the position and are timed as single calls; they take much longer than reading the clock
+template <NnueType Nt, Color c, unsigned int NnueFtHalfdims, unsigned int NnuePsqtBuckets>
+static void BenchAccumulatorUpdate(chessposition* pos, NnueKernelTimer* timer)
+{
+    int updatechain[4];
+    if (pos->computationState[pos->ply][c])
+        return;
+
+    U64 start = timer->now();
+    if (pos->GetAcccumulatorUpdateArray<Nt, c, 3>(updatechain))
+    {
+        pos->AccumulatorIncrementalUpdate<Nt, c, NnueFtHalfdims, NnuePsqtBuckets, 3>(updatechain);
+        timer->add(NnueKernelIncremental, start);
+    }
+    else
+    {
+        pos->AccumulatorRefresh<Nt, c, NnueFtHalfdims, NnuePsqtBuckets>();
+        timer->add(NnueKernelRefresh, start);
+    }
+}
+
 // The network architecture V1
 class NnueArchitectureV1 : public NnueArchitecture {
 public:
@@ -136,6 +169,15 @@ public:
         nr->write((unsigned char*)&nethash, sizeof(uint32_t));
         LayerStack[0].NnueOut.WriteWeights(nr);
     }
+    bool ReadNativeWeights(NnueNetsource* nr) {
+        return LayerStack[0].NnueOut.ReadNativeWeights(nr);
+    }
+    void WriteNativeWeights(NnueNetsource* nr) {
+        LayerStack[0].NnueOut.WriteNativeWeights(nr);
+    }
+    uint32_t GetWeightLayout() {
+        return LayerStack[0].NnueOut.GetWeightLayout();
+    }
     void RescaleLastLayer(int ratio64) {
         LayerStack[0].NnueOut.bias[0] = (int32_t)round(LayerStack[0].NnueOut.bias[0] * ratio64 / sps.nnuevaluescale);
         for (unsigned int i = 0; i < NnueHidden2Dims; i++)
@@ -147,15 +189,16 @@ public:
     string GetArchDescription() {
         return "Features=HalfKP(Friend)[40960->256x2],Network=AffineTransform[1<-32](ClippedReLU[32](AffineTransform[32<-32](ClippedReLU[32](AffineTransform[32<-512](InputSlice[512(0:512)])))))";
     }
+    struct NnueNetwork {
+        alignas(64) clipped_t input[NnueFtOutputdims];
+        alignas(64) int32_t hidden1_values[NnueHidden1Dims];
+        alignas(64) int32_t hidden2_values[NnueHidden2Dims];
+        alignas(64) clipped_t hidden1_clipped[NnueHidden1Dims];
+        alignas(64) clipped_t hidden2_clipped[NnueHidden2Dims];
+        alignas(64) int32_t out_value;
+    };
     int GetEval(chessposition *pos) {
-        struct NnueNetwork {
-            alignas(64) clipped_t input[NnueFtOutputdims];
-            alignas(64) int32_t hidden1_values[NnueHidden1Dims];
-            alignas(64) int32_t hidden2_values[NnueHidden2Dims];
-            alignas(64) clipped_t hidden1_clipped[NnueHidden1Dims];
-            alignas(64) clipped_t hidden2_clipped[NnueHidden2Dims];
-            alignas(64) int32_t out_value;
-        } network;
+        NnueNetwork network;
 
         pos->Transform<NnueArchV1, NnueFtHalfdims, NnuePsqtBuckets>(network.input);
         LayerStack[0].NnueHd1.Propagate(network.input, network.hidden1_values);
@@ -166,9 +209,54 @@ public:
 
         return network.out_value * sps.nnuevaluescale / 1024;
     }
+    void GetEvalBatch(chessposition** pos, int n, int* out) {
+        NnueNetwork network[NNUEBATCHSIZE];
+
+        for (int first = 0; first < n; first += NNUEBATCHSIZE)
+        {
+            const unsigned int num = min(n - first, NNUEBATCHSIZE);
+            for (unsigned int i = 0; i < num; i++)
+                pos[first + i]->Transform<NnueArchV1, NnueFtHalfdims, NnuePsqtBuckets>(network[i].input);
+            LayerStack[0].NnueHd1.PropagateBatch(network[0].input, network[0].hidden1_values, num, sizeof(NnueNetwork));
+            for (unsigned int i = 0; i < num; i++)
+                LayerStack[0].NnueCl1.Propagate(network[i].hidden1_values, network[i].hidden1_clipped);
+            LayerStack[0].NnueHd2.PropagateBatch(network[0].hidden1_clipped, network[0].hidden2_values, num, sizeof(NnueNetwork));
+            for (unsigned int i = 0; i < num; i++)
+                LayerStack[0].NnueCl1.Propagate(network[i].hidden2_values, network[i].hidden2_clipped);
+            LayerStack[0].NnueOut.PropagateBatch(network[0].hidden2_clipped, &network[0].out_value, num, sizeof(NnueNetwork));
+            for (unsigned int i = 0; i < num; i++)
+                out[first + i] = network[i].out_value * sps.nnuevaluescale / 1024;
+        }
+    }
+    void BenchKernels(chessposition* pos, NnueKernelTimer* timer) {
+        NnueNetwork network;
+
+        BenchAccumulatorUpdate<NnueArchV1, WHITE, NnueFtHalfdims, NnuePsqtBuckets>(pos, timer);
+        BenchAccumulatorUpdate<NnueArchV1, BLACK, NnueFtHalfdims, NnuePsqtBuckets>(pos, timer);
+        // the accumulators are up to date so this is the output transform only
+        timer->run(NnueKernelTransform, [&]() { pos->Transform<NnueArchV1, NnueFtHalfdims, NnuePsqtBuckets>(network.input); });
+        timer->run(NnueKernelHidden1, [&]() { LayerStack[0].NnueHd1.Propagate(network.input, network.hidden1_values); });
+        timer->run(NnueKernelClipped1, [&]() { LayerStack[0].NnueCl1.Propagate(network.hidden1_values, network.hidden1_clipped); });
+        timer->run(NnueKernelHidden2, [&]() { LayerStack[0].NnueHd2.Propagate(network.hidden1_clipped, network.hidden2_values); });
+        timer->run(NnueKernelClipped2, [&]() { LayerStack[0].NnueCl1.Propagate(network.hidden2_values, network.hidden2_clipped); });
+        timer->run(NnueKernelOutput, [&]() { LayerStack[0].NnueOut.Propagate(network.hidden2_clipped, &network.out_value); });
+
+        if (timer->name[NnueKernelHidden1].empty())
+        {
+            timer->name[NnueKernelHidden1] = LayerStack[0].NnueHd1.GetPropagateName();
+            timer->name[NnueKernelClipped1] = "ClippedRelu<" + to_string(NnueHidden1Dims) + ">";
+            timer->name[NnueKernelHidden2] = LayerStack[0].NnueHd2.GetPropagateName();
+            timer->name[NnueKernelClipped2] = "ClippedRelu<" + to_string(NnueHidden2Dims) + ">";
+            timer->name[NnueKernelOutput] = LayerStack[0].NnueOut.GetPropagateName();
+        }
+    }
     void SpeculativeEval(chessposition* pos) {
         pos->SpeculativeTransform<NnueArchV1, NnueFtHalfdims, NnuePsqtBuckets>();
     }
+    void PrefetchFeatureWeights(chessposition* pos) {
+        pos->PrefetchFeatureWeights<NnueArchV1, WHITE, NnueFtHalfdims>(NnueFt.weight);
+        pos->PrefetchFeatureWeights<NnueArchV1, BLACK, NnueFtHalfdims>(NnueFt.weight);
+    }
     int16_t* GetFeatureWeight() {
         return NnueFt.weight;
     }
@@ -188,12 +276,12 @@ public:
         return nullptr;
     }
     void CreateAccumulationCache(chessposition* p) {
-        p->accucache.accumulation = (int16_t*)allocalign64(2 * 64 * NnueFtHalfdims * sizeof(int16_t));
+        p->accucache.accumulation = (int16_t*)allocalign64(2 * NNUECACHESLOTS(NnueArchV1) * NnueFtHalfdims * sizeof(int16_t));
         p->accucache.psqtaccumulation = nullptr;
     }
     void ResetAccumulationCache(chessposition* p) {
         memset(p->accucache.piece00, 0, sizeof(p->accucache.piece00));
-        for (int i = 0; i < 2 * 64; i++) {
+        for (int i = 0; i < 2 * NNUECACHESLOTS(NnueArchV1); i++) {
             memcpy(p->accucache.accumulation + i * NnueFtHalfdims, NnueFt.bias, NnueFtHalfdims * sizeof(int16_t));
         }
     }
@@ -206,6 +294,12 @@ public:
     size_t GetNetworkFilesize() {
         return networkfilesize;
     }
+    void GetNativeLayout(NnueNativeHeader* header) {
+        NnueFt.GetNativeLayout(header);
+    }
+    bool MapFeatureWeights(unsigned char* base, NnueNativeHeader* header) {
+        return NnueFt.MapWeights(base, header);
+    }
 #ifdef STATISTICS
     void SwapInputNeurons(unsigned int i1, unsigned int i2) {
         // not supported for V1
@@ -290,6 +384,19 @@ public:
             LayerStack[i].NnueOut.WriteWeights(nr);
         }
     }
+    bool ReadNativeWeights(NnueNetsource* nr) {
+        bool okay = true;
+        for (unsigned int i = 0; okay && i < NnueLayerStacks; i++)
+            okay = LayerStack[i].NnueOut.ReadNativeWeights(nr);
+        return okay;
+    }
+    void WriteNativeWeights(NnueNetsource* nr) {
+        for (unsigned int i = 0; i < NnueLayerStacks; i++)
+            LayerStack[i].NnueOut.WriteNativeWeights(nr);
+    }
+    uint32_t GetWeightLayout() {
+        return LayerStack[0].NnueOut.GetWeightLayout();
+    }
     void RescaleLastLayer(int ratio64) {
         for (unsigned int b = 0; b < NnueLayerStacks; b++) {
             LayerStack[b].NnueOut.bias[0] = (int32_t)round(LayerStack[b].NnueOut.bias[0] * ratio64 / sps.nnuevaluescale);
@@ -303,16 +410,17 @@ public:
     string GetArchDescription() {
         return "HalfKAv2_hm, " + to_string(NnueFtOutputdims) + "x16+16x32x1";
     }
+    struct NnueNetwork {
+        alignas(64) clipped_t input[NnueFtOutputdims];
+        alignas(64)int32_t hidden1_values[NnueHidden1Dims];
+        alignas(64)int32_t hidden2_values[NnueHidden2Dims];
+        alignas(64)clipped_t hidden1_sqrclipped[MULTIPLEOFN(NnueHidden1Out, 32)];
+        alignas(64)clipped_t hidden1_clipped[NnueHidden1Dims];
+        alignas(64)clipped_t hidden2_clipped[NnueHidden2Dims];
+        alignas(64)int32_t out_value;
+    };
     int GetEval(chessposition* pos) {
-        struct NnueNetwork {
-            alignas(64) clipped_t input[NnueFtOutputdims];
-            alignas(64)int32_t hidden1_values[NnueHidden1Dims];
-            alignas(64)int32_t hidden2_values[NnueHidden2Dims];
-            alignas(64)clipped_t hidden1_sqrclipped[MULTIPLEOFN(NnueHidden1Out, 32)];
-            alignas(64)clipped_t hidden1_clipped[NnueHidden1Dims];
-            alignas(64)clipped_t hidden2_clipped[NnueHidden2Dims];
-            alignas(64)int32_t out_value;
-        } network;
+        NnueNetwork network;
 
         int bucket = (POPCOUNT(pos->occupied00[WHITE] | pos->occupied00[BLACK]) - 1) / 4;
         int psqt = pos->Transform<NnueArchV5, NnueFtHalfdims, NnuePsqtBuckets>(network.input, bucket);
@@ -335,9 +443,82 @@ public:
 
         return (psqt + positional) * sps.nnuevaluescale / 1024;
     }
+    void GetEvalBatch(chessposition** pos, int n, int* out) {
+        NnueNetwork network[NNUEBATCHSIZE];
+        int index[NNUEBATCHSIZE];
+        int psqt[NNUEBATCHSIZE];
+
+        // Collect the positions per layer stack so each batch runs through the weights of a single stack
+        for (int bucket = 0; bucket < (int)NnueLayerStacks; bucket++)
+        {
+            unsigned int num = 0;
+            for (int j = 0; j <= n; j++)
+            {
+                if (j < n && (POPCOUNT(pos[j]->occupied00[WHITE] | pos[j]->occupied00[BLACK]) - 1) / 4 == bucket)
+                {
+                    index[num] = j;
+                    psqt[num] = pos[j]->Transform<NnueArchV5, NnueFtHalfdims, NnuePsqtBuckets>(network[num].input, bucket);
+                    num++;
+                }
+                if (num == 0 || (num < NNUEBATCHSIZE && j < n))
+                    continue;
+
+                LayerStack[bucket].NnueHd1.PropagateBatch(network[0].input, network[0].hidden1_values, num, sizeof(NnueNetwork));
+                for (unsigned int i = 0; i < num; i++)
+                {
+                    memset(network[i].hidden1_sqrclipped, 0, sizeof(network[i].hidden1_sqrclipped));
+                    LayerStack[bucket].NnueSqrCl.Propagate(network[i].hidden1_values, network[i].hidden1_sqrclipped);
+                    LayerStack[bucket].NnueCl1.Propagate(network[i].hidden1_values, network[i].hidden1_clipped);
+                    memcpy(network[i].hidden1_sqrclipped + NnueHidden1Out, network[i].hidden1_clipped, NnueHidden1Out * sizeof(clipped_t));
+                }
+                LayerStack[bucket].NnueHd2.PropagateBatch(network[0].hidden1_sqrclipped, network[0].hidden2_values, num, sizeof(NnueNetwork));
+                for (unsigned int i = 0; i < num; i++)
+                    LayerStack[bucket].NnueCl2.Propagate(network[i].hidden2_values, network[i].hidden2_clipped);
+                LayerStack[bucket].NnueOut.PropagateBatch(network[0].hidden2_clipped, &network[0].out_value, num, sizeof(NnueNetwork));
+
+                for (unsigned int i = 0; i < num; i++)
+                {
+                    int fwdout = network[i].hidden1_values[NnueHidden1Out] * (600 * 1024 / sps.nnuevaluescale) / (127 * (1 << NnueClippingShift));
+                    out[index[i]] = (psqt[i] + network[i].out_value + fwdout) * sps.nnuevaluescale / 1024;
+                }
+                num = 0;
+            }
+        }
+    }
+    void BenchKernels(chessposition* pos, NnueKernelTimer* timer) {
+        NnueNetwork network;
+
+        int bucket = (POPCOUNT(pos->occupied00[WHITE] | pos->occupied00[BLACK]) - 1) / 4;
+        BenchAccumulatorUpdate<NnueArchV5, WHITE, NnueFtHalfdims, NnuePsqtBuckets>(pos, timer);
+        BenchAccumulatorUpdate<NnueArchV5, BLACK, NnueFtHalfdims, NnuePsqtBuckets>(pos, timer);
+        // the accumulators are up to date so this is the output transform only
+        timer->run(NnueKernelTransform, [&]() { pos->Transform<NnueArchV5, NnueFtHalfdims, NnuePsqtBuckets>(network.input, bucket); });
+        timer->run(NnueKernelHidden1, [&]() { LayerStack[bucket].NnueHd1.Propagate(network.input, network.hidden1_values); });
+        memset(network.hidden1_sqrclipped, 0, sizeof(network.hidden1_sqrclipped));
+        timer->run(NnueKernelSqrClipped1, [&]() { LayerStack[bucket].NnueSqrCl.Propagate(network.hidden1_values, network.hidden1_sqrclipped); });
+        timer->run(NnueKernelClipped1, [&]() { LayerStack[bucket].NnueCl1.Propagate(network.hidden1_values, network.hidden1_clipped); });
+        memcpy(network.hidden1_sqrclipped + NnueHidden1Out, network.hidden1_clipped, NnueHidden1Out * sizeof(clipped_t));
+        timer->run(NnueKernelHidden2, [&]() { LayerStack[bucket].NnueHd2.Propagate(network.hidden1_sqrclipped, network.hidden2_values); });
+        timer->run(NnueKernelClipped2, [&]() { LayerStack[bucket].NnueCl2.Propagate(network.hidden2_values, network.hidden2_clipped); });
+        timer->run(NnueKernelOutput, [&]() { LayerStack[bucket].NnueOut.Propagate(network.hidden2_clipped, &network.out_value); });
+
+        if (timer->name[NnueKernelHidden1].empty())
+        {
+            timer->name[NnueKernelHidden1] = LayerStack[0].NnueHd1.GetPropagateName();
+            timer->name[NnueKernelSqrClipped1] = "SqrClippedRelu<" + to_string(NnueHidden1Dims) + ">";
+            timer->name[NnueKernelClipped1] = "ClippedRelu<" + to_string(NnueHidden1Dims) + ">";
+            timer->name[NnueKernelHidden2] = LayerStack[0].NnueHd2.GetPropagateName();
+            timer->name[NnueKernelClipped2] = "ClippedRelu<" + to_string(NnueHidden2Dims) + ">";
+            timer->name[NnueKernelOutput] = LayerStack[0].NnueOut.GetPropagateName();
+        }
+    }
     void SpeculativeEval(chessposition* pos) {
         pos->SpeculativeTransform<NnueArchV5, NnueFtHalfdims, NnuePsqtBuckets>();
     }
+    void PrefetchFeatureWeights(chessposition* pos) {
+        pos->PrefetchFeatureWeights<NnueArchV5, WHITE, NnueFtHalfdims>(NnueFt.weight);
+        pos->PrefetchFeatureWeights<NnueArchV5, BLACK, NnueFtHalfdims>(NnueFt.weight);
+    }
     int16_t* GetFeatureWeight() {
         return NnueFt.weight;
     }
@@ -357,15 +538,15 @@ public:
         return (int32_t*)allocalign64(MAXDEPTH * 2 * NnuePsqtBuckets * sizeof(int32_t));
     }
     void CreateAccumulationCache(chessposition* p) {
-        p->accucache.accumulation = (int16_t*)allocalign64(2 * 64 * NnueFtHalfdims * sizeof(int16_t));
-        p->accucache.psqtaccumulation = (int32_t*)allocalign64(2 * 64 * NnuePsqtBuckets * sizeof(int32_t));
+        p->accucache.accumulation = (int16_t*)allocalign64(2 * NNUECACHESLOTS(NnueArchV5) * NnueFtHalfdims * sizeof(int16_t));
+        p->accucache.psqtaccumulation = (int32_t*)allocalign64(2 * NNUECACHESLOTS(NnueArchV5) * NnuePsqtBuckets * sizeof(int32_t));
     }
     void ResetAccumulationCache(chessposition* p) {
         memset(p->accucache.piece00, 0, 2 * sizeof(p->accucache.piece00[WHITE]));
-        for (int i = 0; i < 2 * 64; i++)
+        for (int i = 0; i < 2 * NNUECACHESLOTS(NnueArchV5); i++)
             memcpy(p->accucache.accumulation + i * NnueFtHalfdims, NnueFt.bias, NnueFtHalfdims * sizeof(int16_t));
             
-        memset(p->accucache.psqtaccumulation, 0, 2 * 64 * NnuePsqtBuckets * sizeof(int32_t));
+        memset(p->accucache.psqtaccumulation, 0, 2 * NNUECACHESLOTS(NnueArchV5) * NnuePsqtBuckets * sizeof(int32_t));
     }
     unsigned int GetAccumulationSize() {
         return NnueFtOutputdims;
@@ -376,6 +557,12 @@ public:
     size_t GetNetworkFilesize() {
         return networkfilesize;
     }
+    void GetNativeLayout(NnueNativeHeader* header) {
+        NnueFt.GetNativeLayout(header);
+    }
+    bool MapFeatureWeights(unsigned char* base, NnueNativeHeader* header) {
+        return NnueFt.MapWeights(base, header);
+    }
 #ifdef STATISTICS
     void SwapInputNeurons(unsigned int i1, unsigned int i2) {
         if (i1 >= NnueFtHalfdims / 2 || i2 >= NnueFtHalfdims / 2) {
@@ -540,6 +727,7 @@ inline ft_vec_t vec_msb_pack_16(ft_vec_t a, ft_vec_t b) {
 #define vec_nnz(a) _mm512_cmpgt_epi32_mask(a, _mm512_setzero_si512())
 #define vec_set_32 _mm512_set1_epi32
 #define vec_add_dpbusd_32 Simd::m512_add_dpbusd_32
+#define vec_add_32(a,b) _mm512_add_epi32(a,b)
 
 #elif defined(USE_AVX2)
 #define NUM_REGS 16
@@ -574,6 +762,7 @@ inline ft_vec_t vec_msb_pack_16(ft_vec_t a, ft_vec_t b) {
 #define vec_nnz(a) _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(a, _mm256_setzero_si256())))
 #define vec_set_32 _mm256_set1_epi32
 #define vec_add_dpbusd_32 Simd::m256_add_dpbusd_32
+#define vec_add_32(a,b) _mm256_add_epi32(a,b)
 
 #elif defined(USE_SSE2)
 #define NUM_REGS 16
@@ -607,6 +796,7 @@ typedef __m128i ft_vec_t, ftout_vec_t, in_vec_t, acc_vec_t, weight_vec_t, bias_v
 #define vec_nnz(a) _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(a, _mm_setzero_si128())))
 #define vec_set_32 _mm_set1_epi32
 #define vec_add_dpbusd_32 Simd::m128_add_dpbusd_32
+#define vec_add_32(a,b) _mm_add_epi32(a,b)
 
 #else // USE_SSSE3
 #define vec_clip_8(a,b) _mm_subs_epi8(_mm_adds_epi8(_mm_packs_epi16(a, b), _mm_set1_epi8(-128)), _mm_set1_epi8(-128))
@@ -658,6 +848,7 @@ static const uint32_t NnzMask[4] = { 1, 2, 4, 8 };
 #else
 #define vec_add_dpbusd_32 Simd::neon_m128_add_dpbusd_32
 #endif
+#define vec_add_32(a,b) vaddq_s32(a,b)
 #endif
 
 #else
@@ -784,6 +975,24 @@ template <NnueType Nt, Color c, unsigned int NnueFtHalfdims, unsigned int NnuePs
 }
 
 
+// Called after a move is played: prefetch the start of the weight columns that the incremental update of the accumulator will read
+template <NnueType Nt, Color c, unsigned int NnueFtHalfdims> void chessposition::PrefetchFeatureWeights(int16_t* weight)
+{
+    DirtyPiece* dp = &dirtypiece[ply];
+    if (dp->pc[0] == (WKING | c))
+        // king move of this side needs a refresh of the accumulator
+        return;
+
+    NnueIndexList addedIndices, removedIndices;
+    addedIndices.size = removedIndices.size = 0;
+    HalfkpAppendChangedIndices<Nt, c>(dp, &addedIndices, &removedIndices);
+    for (size_t k = 0; k < removedIndices.size; k++)
+        PREFETCH(weight + NnueFtHalfdims * removedIndices.values[k]);
+    for (size_t k = 0; k < addedIndices.size; k++)
+        PREFETCH(weight + NnueFtHalfdims * addedIndices.values[k]);
+}
+
+
 template <NnueType Nt, Color c, unsigned int NnueFtHalfdims, unsigned int NnuePsqtBuckets, int N> void chessposition::AccumulatorIncrementalUpdate(int* updaterequest)
 {
 #ifdef NNUEDEBUG
@@ -977,35 +1186,42 @@ template <NnueType Nt, Color c, unsigned int NnueFtHalfdims, unsigned int NnuePs
 
     const int ksq = kingpos[c];
     const int oksq = (Nt == NnueArchV1 ? ORIENT(c, ksq) : HMORIENT(c, ksq, ksq));
-    U64* cachedpiece00 = (U64*) & (accucache.piece00[c][ksq]);
-    int16_t* cacheaccumulation = accucache.accumulation + (c * 64 + ksq) * NnueFtHalfdims;
-    int32_t* cachepsqtaccumulation = accucache.psqtaccumulation + (c * 64 + ksq) * NnuePsqtBuckets;
+    // HalfKAv2_hm: Both king squares of a bucket share the cache slot with the board mirrored to the king side
+    const int slot = (Nt == NnueArchV1 ? ksq : KingBucket[oksq]);
+    const bool mirror = (Nt != NnueArchV1 && FILE(ksq) < 4);
+    U64* cachedpiece00 = (U64*) & (accucache.piece00[c][slot]);
+    int16_t* cacheaccumulation = accucache.accumulation + (c * NNUECACHESLOTS(Nt) + slot) * NnueFtHalfdims;
+    int32_t* cachepsqtaccumulation = accucache.psqtaccumulation + (c * NNUECACHESLOTS(Nt) + slot) * NnuePsqtBuckets;
     unsigned int index;
     NnueIndexList addedIndices, removedIndices;
     addedIndices.size = removedIndices.size = 0;
     for (int p = WPAWN; p <= (Nt == NnueArchV1 ? BQUEEN : BKING); p++)
     {
-        U64 addedbb = piece00[p] & ~cachedpiece00[p];
+        const U64 bb = (mirror ? mirrorFiles(piece00[p]) : piece00[p]);
+        U64 addedbb = bb & ~cachedpiece00[p];
         while (addedbb)
         {
             index = pullLsb(&addedbb);
             if (Nt == NnueArchV1)
                 addedIndices.values[addedIndices.size++] = ORIENT(c, index) + PieceToIndex[c][p] + PS_KPEND * oksq;
             else
-                addedIndices.values[addedIndices.size++] = HMORIENT(c, index, ksq) + PieceToIndex[c][p] + PS_KAEND * KingBucket[oksq];
+                addedIndices.values[addedIndices.size++] = (index ^ (bool(c) * 56)) + PieceToIndex[c][p] + PS_KAEND * KingBucket[oksq];
         }
-        U64 removedbb = ~piece00[p] & cachedpiece00[p];
+        U64 removedbb = ~bb & cachedpiece00[p];
         while (removedbb)
         {
             index = pullLsb(&removedbb);
             if (Nt == NnueArchV1)
                 removedIndices.values[removedIndices.size++] = ORIENT(c, index) + PieceToIndex[c][p] + PS_KPEND * oksq;
             else
-                removedIndices.values[removedIndices.size++] = HMORIENT(c, index, ksq) + PieceToIndex[c][p] + PS_KAEND * KingBucket[oksq];
+                removedIndices.values[removedIndices.size++] = (index ^ (bool(c) * 56)) + PieceToIndex[c][p] + PS_KAEND * KingBucket[oksq];
         }
+        cachedpiece00[p] = bb;
     }
 
-    memcpy(cachedpiece00, piece00, sizeof(piece00));
+    STATISTICSADD(nnue_refresh_features, addedIndices.size + removedIndices.size);
+    STATISTICSADD(nnue_refresh_active, POPCOUNT(occupied00[0] | occupied00[1]) - (Nt == NnueArchV1 ? 2 : 0));
+    STATISTICSINC(nnue_refresh_slot[c][slot]);
 
     int16_t* weight = NnueCurrentArch->GetFeatureWeight();
     int32_t* psqtweight = NnueCurrentArch->GetFeaturePsqtWeight();
@@ -1255,7 +1471,8 @@ int chessposition::NnueGetEval()
 
 void chessposition::NnueSpeculativeEval()
 {
-    NnueCurrentArch->SpeculativeEval(this);
+    if (NnueReady)
+        NnueCurrentArch->SpeculativeEval(this);
 }
 
 
@@ -1277,67 +1494,207 @@ static bool testLeb128(NnueNetsource* nr)
 }
 
 
+// Decode count values of a leb128 stream; returns the position behind the last value or nullptr if the stream ends before
 template <typename IntType>
-bool readLeb128(NnueNetsource* nr, IntType *out, size_t count)
+static const uint8_t* decodeLeb128(const uint8_t* in, const uint8_t* end, IntType* out, size_t count)
 {
-    const uint32_t BUF_SIZE = 4096;
-    uint8_t buf[BUF_SIZE];
-    uint32_t bytes_left = 0;
-    bool okay = nr->read((unsigned char*)&bytes_left, sizeof(uint32_t));
-
-    uint32_t buf_pos = BUF_SIZE;
     for (size_t i = 0; i < count; ++i)
     {
         IntType result = 0;
         size_t shift = 0;
+        uint8_t nextbyte;
         do
         {
-            if (buf_pos == BUF_SIZE)
-            {
-                okay = okay && nr->read((unsigned char*)buf, min(bytes_left, BUF_SIZE));
-                buf_pos = 0;
-            }
-
-            uint8_t nextbyte = buf[buf_pos++];
-            bytes_left--;
+            if (in == end)
+                return nullptr;
+            nextbyte = *in++;
             result |= (nextbyte & 0x7f) << shift;
             shift += 7;
+        } while ((nextbyte & 0x80) && shift < sizeof(IntType) * 8);
+        out[i] = (sizeof(IntType) * 8 <= shift || (nextbyte & 0x40) == 0) ? result : result | ~((1 << shift) - 1);
+    }
+    return in;
+}
 
-            if ((nextbyte & 0x80) == 0)
-            {
-                out[i] = (sizeof(IntType) * 8 <= shift || (nextbyte & 0x40) == 0) ? result : result | ~((1 << shift) - 1);
-                break;
-            }
-        } while (shift < sizeof(IntType) * 8);
+
+// Decoding of big leb128 streams is split over the threads of the pool: Every thread decodes the values that end
+// (byte without continuation bit) in its part of the stream; the index of its first value is known after counting
+// the value ends of all parts.
+static struct {
+    const uint8_t* in;
+    size_t bytes;
+    void* out;
+    size_t first[MAXTHREADS + 1];
+    bool okay[MAXTHREADS];
+} leb128Job;
+
+static void countLeb128Ends(workingthread* thr)
+{
+    size_t begin = leb128Job.bytes * thr->index / en.Threads;
+    size_t end = leb128Job.bytes * (thr->index + 1) / en.Threads;
+    size_t n = 0;
+    for (size_t i = begin; i < end; i++)
+        n += !(leb128Job.in[i] & 0x80);
+    leb128Job.first[thr->index + 1] = n;
+}
+
+template <typename IntType>
+static void decodeLeb128Part(workingthread* thr)
+{
+    size_t begin = leb128Job.bytes * thr->index / en.Threads;
+    size_t end = leb128Job.bytes * (thr->index + 1) / en.Threads;
+
+    // go back to the start of the first value ending in this part
+    while (begin > 0 && (leb128Job.in[begin - 1] & 0x80))
+        begin--;
+
+    size_t first = leb128Job.first[thr->index];
+    size_t count = leb128Job.first[thr->index + 1] - first;
+    const uint8_t* next = decodeLeb128(leb128Job.in + begin, leb128Job.in + leb128Job.bytes, (IntType*)leb128Job.out + first, count);
+    leb128Job.okay[thr->index] = (next && next <= leb128Job.in + end);
+}
+
+
+template <typename IntType>
+bool readLeb128(NnueNetsource* nr, IntType *out, size_t count)
+{
+    uint32_t bytes = 0;
+    if (!nr->read((unsigned char*)&bytes, sizeof(uint32_t)) || nr->next + bytes > nr->readbuffer + nr->readbuffersize)
+        return false;
+
+    const uint8_t* in = nr->next;
+    nr->next += bytes;
+
+    if (en.Threads < 2 || bytes < (1 << 20))
+        return decodeLeb128(in, in + bytes, out, count) == in + bytes;
+
+    leb128Job.in = in;
+    leb128Job.bytes = bytes;
+    leb128Job.out = out;
+    leb128Job.first[0] = 0;
+    for (int i = 0; i < en.Threads; i++)
+        en.sthread[i].run_job(countLeb128Ends);
+    for (int i = 0; i < en.Threads; i++)
+        en.sthread[i].wait_for_work_finished();
+
+    for (int i = 0; i < en.Threads; i++)
+        leb128Job.first[i + 1] += leb128Job.first[i];
+    if (leb128Job.first[en.Threads] != count || (in[bytes - 1] & 0x80))
+        return false;
+
+    for (int i = 0; i < en.Threads; i++)
+        en.sthread[i].run_job(decodeLeb128Part<IntType>);
+    for (int i = 0; i < en.Threads; i++)
+        en.sthread[i].wait_for_work_finished();
+
+    bool okay = true;
+    for (int i = 0; i < en.Threads; i++)
+        okay = okay && leb128Job.okay[i];
+
+    return okay;
+}
+
+
+template <int ftdims, int inputdims, int psqtbuckets>
+bool NnueFeatureTransformer<ftdims, inputdims, psqtbuckets>::AllocWeights()
+{
+    if (weight && !mappedWeights)
+        return true;
+
+    int16_t* newweight = (int16_t*)my_large_malloc(inputdims * ftdims * sizeof(int16_t));
+    int32_t* newpsqtweights = (psqtbuckets ? (int32_t*)allocalign64(inputdims * psqtbuckets * sizeof(int32_t)) : nullptr);
+    if (!newweight || (psqtbuckets && !newpsqtweights))
+    {
+        my_large_free(newweight);
+        if (newpsqtweights)
+            freealigned64(newpsqtweights);
+        return false;
+    }
+
+    if (mappedWeights)
+    {
+        // get a private copy of the mapped weights
+        memcpy(newweight, weight, inputdims * ftdims * sizeof(int16_t));
+        if (psqtbuckets)
+            memcpy(newpsqtweights, psqtWeights, inputdims * psqtbuckets * sizeof(int32_t));
     }
 
-    return okay && (bytes_left == 0);
+    weight = newweight;
+    psqtWeights = newpsqtweights;
+    mappedWeights = false;
+    return true;
 }
 
 
 template <int ftdims, int inputdims, int psqtbuckets>
-bool NnueFeatureTransformer<ftdims, inputdims, psqtbuckets>::ReadFeatureWeights(NnueNetsource* nr, bool bpz)
+void NnueFeatureTransformer<ftdims, inputdims, psqtbuckets>::FreeWeights()
 {
-    int i;
-    bool okay = true;
+    // mapped weights belong to the mapping of the network file
+    if (!mappedWeights)
+    {
+        my_large_free(weight);
+        if (psqtWeights)
+            freealigned64(psqtWeights);
+    }
+    weight = nullptr;
+    psqtWeights = nullptr;
+    mappedWeights = false;
+}
+
+
+template <int ftdims, int inputdims, int psqtbuckets>
+void NnueFeatureTransformer<ftdims, inputdims, psqtbuckets>::GetNativeLayout(NnueNativeHeader* header)
+{
+    header->ftdims = ftdims;
+    header->inputdims = inputdims;
+    header->psqtbuckets = psqtbuckets;
+    header->biasoffset = MULTIPLEOFN(sizeof(NnueNativeHeader), 64);
+    header->weightoffset = header->biasoffset + MULTIPLEOFN(ftdims * sizeof(int16_t), 64);
+    header->psqtoffset = header->weightoffset + MULTIPLEOFN((uint64_t)inputdims * ftdims * sizeof(int16_t), 64);
+    header->nativelayeroffset = header->psqtoffset + MULTIPLEOFN((uint64_t)inputdims * psqtbuckets * sizeof(int32_t), 64);
+}
+
 
-    int16_t* src_16 = (int16_t*)calloc(inputdims * ftdims, sizeof(int16_t));
-    if (!src_16)
+template <int ftdims, int inputdims, int psqtbuckets>
+bool NnueFeatureTransformer<ftdims, inputdims, psqtbuckets>::MapWeights(unsigned char* base, NnueNativeHeader* header)
+{
+    NnueNativeHeader layout;
+    GetNativeLayout(&layout);
+    if (header->ftdims != layout.ftdims
+        || header->inputdims != layout.inputdims
+        || header->psqtbuckets != layout.psqtbuckets
+        || header->biasoffset != layout.biasoffset
+        || header->weightoffset != layout.weightoffset
+        || header->psqtoffset != layout.psqtoffset
+        || header->nativelayeroffset != layout.nativelayeroffset)
         return false;
 
+    FreeWeights();
+    memcpy(bias, base + header->biasoffset, ftdims * sizeof(int16_t));
+    weight = (int16_t*)(base + header->weightoffset);
+    psqtWeights = (psqtbuckets ? (int32_t*)(base + header->psqtoffset) : nullptr);
+    mappedWeights = true;
+    return true;
+}
+
+
+template <int ftdims, int inputdims, int psqtbuckets>
+bool NnueFeatureTransformer<ftdims, inputdims, psqtbuckets>::ReadFeatureWeights(NnueNetsource* nr, bool bpz)
+{
+    int i;
+    bool okay = AllocWeights();
+
     // read bias
     bool isLeb128 = testLeb128(nr);
     if (isLeb128)
-        okay = okay && readLeb128(nr, src_16, ftdims);
+        okay = okay && readLeb128(nr, bias, ftdims);
     else
-        okay = okay && nr->read((unsigned char*)src_16, ftdims * sizeof(int16_t));
-
-    memcpy(bias, src_16, ftdims * sizeof(int16_t));
+        okay = okay && nr->read((unsigned char*)bias, ftdims * sizeof(int16_t));
 
-    // read weights
+    // read weights directly to their final place
     isLeb128 = testLeb128(nr);
     if (isLeb128) {
-        okay = okay && readLeb128(nr, src_16, inputdims * ftdims);
+        okay = okay && readLeb128(nr, weight, inputdims * ftdims);
     }
     else {
         // Handle bpz
@@ -1346,30 +1703,19 @@ bool NnueFeatureTransformer<ftdims, inputdims, psqtbuckets>::ReadFeatureWeights(
         for (i = 0; i < inputdims; i++) {
             if (bpz && i % (10 * 64) == 0)
                 okay = okay && nr->read((unsigned char*)dummyweight, ftdims * sizeof(int16_t));
-            okay = okay && nr->read((unsigned char*)(src_16 + weightsRead), ftdims * sizeof(int16_t));
+            okay = okay && nr->read((unsigned char*)(weight + weightsRead), ftdims * sizeof(int16_t));
             weightsRead += ftdims;
         }
     }
-    
-    memcpy(weight, src_16, inputdims * ftdims * sizeof(int16_t));
-    free(src_16);
 
     if (psqtbuckets)
     {
         // read psqt weights
-        size_t psqt_size = inputdims * psqtbuckets;
-        int32_t* src_32 = (int32_t*)calloc(psqt_size, sizeof(int32_t));
-        if (!src_32)
-            return false;
-
         isLeb128 = testLeb128(nr);
         if (isLeb128)
-            okay = okay && readLeb128(nr, src_32, inputdims * psqtbuckets);
+            okay = okay && readLeb128(nr, psqtWeights, inputdims * psqtbuckets);
         else
-            okay = okay && nr->read((unsigned char*)src_32, inputdims * psqtbuckets * sizeof(int32_t));
-
-        memcpy(psqtWeights, src_32, inputdims * psqtbuckets * sizeof(int32_t));
-        free(src_32);
+            okay = okay && nr->read((unsigned char*)psqtWeights, inputdims * psqtbuckets * sizeof(int32_t));
     }
     return okay;
 }
@@ -1619,6 +1965,23 @@ void NnueNetworkLayer<inputdims, outputdims>::Propagate(clipped_t* input, int32_
 }
 
 
+// Propagate n inputs that are stride bytes apart to the outputs with the same stride
+template <unsigned int inputdims, unsigned int outputdims>
+void NnueNetworkLayer<inputdims, outputdims>::PropagateBatch(clipped_t* input, int32_t* output, unsigned int n, size_t stride)
+{
+#ifdef USE_PROPAGATESMALL
+    if (useSmallLayerPropagation && outputdims % OutputSimdWidth == 0)
+    {
+        PropagateSmallLayerBatch(input, output, n, stride);
+        return;
+    }
+#endif
+    // Sparse and big layers: the weights stay in the cache while the inputs are processed one after another
+    for (unsigned int i = 0; i < n; i++)
+        Propagate((clipped_t*)((char*)input + i * stride), (int32_t*)((char*)output + i * stride));
+}
+
+
 #ifdef USE_PROPAGATESMALL
 template <unsigned int inputdims, unsigned int outputdims>
 inline void NnueNetworkLayer<inputdims, outputdims>::PropagateSmallLayer(clipped_t* input, int32_t* output)
@@ -1663,6 +2026,53 @@ inline void NnueNetworkLayer<inputdims, outputdims>::PropagateSmallLayer(clipped
         output[0] = vec_hadd(sum0, bias[0]);
     }
 }
+
+
+template <unsigned int inputdims, unsigned int outputdims>
+inline void NnueNetworkLayer<inputdims, outputdims>::PropagateSmallLayerBatch(clipped_t* input, int32_t* output, unsigned int n, size_t stride)
+{
+    // Small layer matrix-matrix propagation: each weight column is loaded once for two inputs
+    constexpr unsigned int numChunks = paddedInputdims / 4;
+    const sml_vec_t* biasvec = (sml_vec_t*)bias;
+
+    unsigned int b = 0;
+    for (; b + 1 < n; b += 2)
+    {
+        const int32_t* inputA = (int32_t*)((char*)input + b * stride);
+        const int32_t* inputB = (int32_t*)((char*)input + (b + 1) * stride);
+        sml_vec_t accA[NumOutputRegsSmall];
+        sml_vec_t accB[NumOutputRegsSmall];
+        for (unsigned int k = 0; k < NumOutputRegsSmall; ++k)
+            accA[k] = accB[k] = biasvec[k];
+
+        for (unsigned int i = 0; i < numChunks; i += 2)
+        {
+            const sml_vec_t inA0 = vec_setsml_32(inputA[i + 0]);
+            const sml_vec_t inA1 = vec_setsml_32(inputA[i + 1]);
+            const sml_vec_t inB0 = vec_setsml_32(inputB[i + 0]);
+            const sml_vec_t inB1 = vec_setsml_32(inputB[i + 1]);
+            const sml_vec_t* col0 = (sml_vec_t*)(&weight[(i + 0) * outputdims * 4]);
+            const sml_vec_t* col1 = (sml_vec_t*)(&weight[(i + 1) * outputdims * 4]);
+            for (unsigned int k = 0; k < NumOutputRegsSmall; ++k)
+            {
+                const sml_vec_t w0 = col0[k];
+                const sml_vec_t w1 = col1[k];
+                vec_add_dpbusd_32x2(accA[k], inA0, w0, inA1, w1);
+                vec_add_dpbusd_32x2(accB[k], inB0, w0, inB1, w1);
+            }
+        }
+
+        sml_vec_t* outptrA = (sml_vec_t*)((char*)output + b * stride);
+        sml_vec_t* outptrB = (sml_vec_t*)((char*)output + (b + 1) * stride);
+        for (unsigned int k = 0; k < NumOutputRegsSmall; ++k)
+        {
+            outptrA[k] = accA[k];
+            outptrB[k] = accB[k];
+        }
+    }
+    if (b < n)
+        PropagateSmallLayer((clipped_t*)((char*)input + b * stride), (int32_t*)((char*)output + b * stride));
+}
 #endif
 
 
@@ -1775,31 +2185,59 @@ inline void NnueNetworkLayer<inputdims, outputdims>::PropagateSparse(clipped_t*
     cout << "\nSparse propagation:\n";
 #endif
     // Step 2: Process the collected nonzero blocks
+    // Consecutive blocks go to independent accumulators so the dot products don't wait for each other
+    // (with only one output register per block every vpdpbusd would depend on the previous one)
+    constexpr unsigned int NumAccs = (NumRegs < 4 ? 4 / NumRegs : 1);
     const acc_vec_t* biasvec = (const acc_vec_t*)bias;
-    acc_vec_t acc[NumRegs];
-    for (unsigned int k = 0; k < NumRegs; ++k)
-        acc[k] = biasvec[k];
+    const acc_vec_t zero = vec_zero();
+    acc_vec_t acc[NumAccs][NumRegs];
+    for (unsigned int a = 0; a < NumAccs; ++a)
+        for (unsigned int k = 0; k < NumRegs; ++k)
+            acc[a][k] = (a ? zero : biasvec[k]);
 
-    for (unsigned int j = 0; j < count; ++j)
+    unsigned int j = 0;
+    for (; j + NumAccs <= count; j += NumAccs)
+    {
+        for (unsigned int a = 0; a < NumAccs; ++a)
+        {
+            const uint16_t i = nnz[j + a];
+            const sprsin_vec_t in = vec_set_32(input32[i]);
+            const sprsin_vec_t* col = (const sprsin_vec_t*)&weight[i * outputdims * ChunkSize];
+            for (unsigned int k = 0; k < NumRegs; ++k)
+                vec_add_dpbusd_32(acc[a][k], in, col[k]);
+        }
+    }
+    for (; j < count; ++j)
     {
         const uint16_t i = nnz[j];
         const sprsin_vec_t in = vec_set_32(input32[i]);
         const sprsin_vec_t* col = (const sprsin_vec_t*)&weight[i * outputdims * ChunkSize];
         for (unsigned int k = 0; k < NumRegs; ++k)
-            vec_add_dpbusd_32(acc[k], in, col[k]);
+            vec_add_dpbusd_32(acc[0][k], in, col[k]);
+    }
+
 #ifdef NNUEDEBUG
+    for (j = 0; j < count; ++j)
+    {
+        const uint16_t i = nnz[j];
+        const sprsin_vec_t in = vec_set_32(input32[i]);
+        const sprsin_vec_t* col = (const sprsin_vec_t*)&weight[i * outputdims * ChunkSize];
         cout << hex << setfill('0') << setw(3) << i << " " << setfill('0') << setw(8) << input32[i] << "  ";
         cout << "in: " << setfill('0') << setw(16) << ((uint64_t*)&in)[0] << " col: " << setfill('0') << setw(16) << ((uint64_t*)col)[0] << " ";
         if (j % 2)
             cout << "   " << hex << setfill('0') << setw(3) << (int)(j / 8 * 8) << "\n";
         if (j + 1 == count)
             cout << dec << "\n";
-#endif
     }
+#endif
+
+    for (unsigned int a = 1; a < NumAccs; ++a)
+        for (unsigned int k = 0; k < NumRegs; ++k)
+            acc[0][k] = vec_add_32(acc[0][k], acc[a][k]);
 
     acc_vec_t* outptr = (acc_vec_t*)output;
     for (unsigned int k = 0; k < NumRegs; ++k)
-        outptr[k] = acc[k];
+        outptr[k] = acc[0][k];
 }
 #endif
 
@@ -2039,6 +2477,12 @@ void NnueSqrClippedRelu<dims>::Propagate(int32_t* input, clipped_t* output)
 //
 // Global Interface
 //
+
+// Network file in native layout; either mapped or read to an aligned buffer
+static unsigned char* NnueMappedNet = nullptr;
+static size_t NnueMappedNetSize = 0;
+static unsigned char* NnueNativeBuffer = nullptr;
+
 void NnueInit()
 {
     NnueCurrentArch = nullptr;
@@ -2047,9 +2491,149 @@ void NnueInit()
 void NnueRemove()
 {
     if (NnueCurrentArch) {
-        freealigned64(NnueCurrentArch);
+        NnueCurrentArch->~NnueArchitecture();
+        my_large_free(NnueCurrentArch);
         NnueCurrentArch = nullptr;
     }
+    if (NnueMappedNet) {
+        my_unmap_file(NnueMappedNet, NnueMappedNetSize);
+        NnueMappedNet = nullptr;
+    }
+    if (NnueNativeBuffer) {
+        my_large_free(NnueNativeBuffer);
+        NnueNativeBuffer = nullptr;
+    }
+}
+
+// Create the architecture for the file version and dimension of the feature transformer
+static NnueArchitecture* NnueCreateArchitecture(uint32_t version, unsigned int ftdims)
+{
+    char* buffer;
+    switch (version) {
+    case NNUEFILEVERSIONROTATE:
+    case NNUEFILEVERSIONNOBPZ:
+        if (ftdims != NnueArchitectureV1::NnueFtHalfdims)
+            return nullptr;
+        buffer = (char*)my_large_malloc(sizeof(NnueArchitectureV1));
+        return new(buffer) NnueArchitectureV1;
+    case NNUEFILEVERSIONSFNNv5_512:
+    case NNUEFILEVERSIONSFNNv5_768:
+    case NNUEFILEVERSIONSFNNv5_1024:
+        switch (ftdims) {
+        case 512:
+            buffer = (char*)my_large_malloc(sizeof(NnueArchitectureV5<512>));
+            return new(buffer) NnueArchitectureV5<512>;
+        case 768:
+            buffer = (char*)my_large_malloc(sizeof(NnueArchitectureV5<768>));
+            return new(buffer) NnueArchitectureV5<768>;
+        case 1024:
+            buffer = (char*)my_large_malloc(sizeof(NnueArchitectureV5<1024>));
+            return new(buffer) NnueArchitectureV5<1024>;
+        case 1536:
+            buffer = (char*)my_large_malloc(sizeof(NnueArchitectureV5<1536>));
+            return new(buffer) NnueArchitectureV5<1536>;
+        case 2048:
+            buffer = (char*)my_large_malloc(sizeof(NnueArchitectureV5<2048>));
+            return new(buffer) NnueArchitectureV5<2048>;
+        case 2560:
+            buffer = (char*)my_large_malloc(sizeof(NnueArchitectureV5<2560>));
+            return new(buffer) NnueArchitectureV5<2560>;
+        }
+    }
+    return nullptr;
+}
+
+// Load a network in native layout: The feature transformer is used directly from the read-only mapping of the
+// file, so the pages are shared by all processes using this network, and the network layers are copied in the
+// in-memory layout if it matches the SIMD kernels of this binary. A network embedded in the binary (source) is
+// used in place, and the file is read to an aligned buffer if it cannot be mapped.
+static bool NnueReadNativeNet(string filename, unsigned char* source, size_t size)
+{
+    NnueType oldnt = NnueReady;
+    unsigned int oldaccumulationsize = (NnueCurrentArch ? NnueCurrentArch->GetAccumulationSize() : 0);
+    unsigned int oldpsqtaccumulationsize = (NnueCurrentArch ? NnueCurrentArch->GetPsqtAccumulationSize() : 0);
+
+    NnueReady = NnueDisabled;
+
+    NnueRemove();
+
+    unsigned char* base = source;
+    if (filename != "") {
+        base = NnueMappedNet = (unsigned char*)my_map_file(filename, &size);
+        NnueMappedNetSize = size;
+        if (!base) {
+            struct stat stat_buf;
+            ifstream is;
+            is.open(filename, ios::binary);
+            if (!is || stat(filename.c_str(), &stat_buf) != 0)
+                return false;
+            size = stat_buf.st_size;
+            base = NnueNativeBuffer = (unsigned char*)my_large_malloc(size);
+            if (!base || !is.read((char*)base, size)) {
+                NnueRemove();
+                return false;
+            }
+        }
+    }
+    else if ((uintptr_t)base & 63) {
+        // the weights need to be aligned for the SIMD kernels
+        base = NnueNativeBuffer = (unsigned char*)my_large_malloc(size);
+        if (!base)
+            return false;
+        memcpy(base, source, size);
+    }
+
+    NnueNativeHeader* header = (NnueNativeHeader*)base;
+    if (size < sizeof(NnueNativeHeader)
+        || memcmp(header->magic, NNUENATIVEMAGIC, sizeof(header->magic)) != 0
+        || header->nativeversion != NNUENATIVEVERSION
+        || header->nativelayeroffset + header->nativelayersize > header->layeroffset
+        || header->layeroffset + header->layersize != size)
+    {
+        NnueRemove();
+        return false;
+    }
+
+    NnueType nt = (header->fileversion == NNUEFILEVERSIONROTATE || header->fileversion == NNUEFILEVERSIONNOBPZ ? NnueArchV1 : NnueArchV5);
+    NnueCurrentArch = NnueCreateArchitecture(header->fileversion, header->ftdims);
+    if (!NnueCurrentArch
+        || (NnueCurrentArch->GetFtHash() ^ NnueCurrentArch->GetHash()) != header->hash
+        || !NnueCurrentArch->MapFeatureWeights(base, header))
+    {
+        NnueRemove();
+        return false;
+    }
+
+    bool native = (header->weightlayout == NnueCurrentArch->GetWeightLayout());
+#ifdef EVALOPTIONS
+    // the layer weights are registered as options while reading them in the usual format
+    native = false;
+#endif
+
+    // Read the weights of the network layers
+    NnueNetsource nr;
+    nr.readbuffer = base + (native ? header->nativelayeroffset : header->layeroffset);
+    nr.readbuffersize = (native ? header->nativelayersize : header->layersize);
+    nr.next = nr.readbuffer;
+    bool okay = (native ? NnueCurrentArch->ReadNativeWeights(&nr) : NnueCurrentArch->ReadWeights(&nr, NnueCurrentArch->GetHash()))
+        && nr.endOfNet();
+    nr.readbuffer = nullptr;    // part of the native network
+    if (!okay)
+    {
+        NnueRemove();
+        return false;
+    }
+
+    NnueReady = nt;
+
+    if (oldnt != NnueReady
+        || oldaccumulationsize != NnueCurrentArch->GetAccumulationSize()
+        || oldpsqtaccumulationsize != NnueCurrentArch->GetPsqtAccumulationSize())
+    {
+        en.allocThreads();
+    }
+
+    return true;
 }
 
 bool NnueReadNet(NnueNetsource* nr)
@@ -2084,13 +2668,13 @@ bool NnueReadNet(NnueNetsource* nr)
     case NNUEFILEVERSIONROTATE:
         bpz = true;
         nt = NnueArchV1;
-        buffer = (char*)allocalign64(sizeof(NnueArchitectureV1));
+        buffer = (char*)my_large_malloc(sizeof(NnueArchitectureV1));
         NnueCurrentArch = new(buffer) NnueArchitectureV1;
         break;
     case NNUEFILEVERSIONNOBPZ:
         bpz = false;
         nt = NnueArchV1;
-        buffer = (char*)allocalign64(sizeof(NnueArchitectureV1));
+        buffer = (char*)my_large_malloc(sizeof(NnueArchitectureV1));
         NnueCurrentArch = new(buffer) NnueArchitectureV1;
         break;
     case NNUEFILEVERSIONSFNNv5_512:
@@ -2100,24 +2684,24 @@ bool NnueReadNet(NnueNetsource* nr)
         bpz = false;
         switch (remainingfilesize) {
         case NnueArchitectureV5<512>::networkfilesize:
-            buffer = (char*)allocalign64(sizeof(NnueArchitectureV5<512>));
+            buffer = (char*)my_large_malloc(sizeof(NnueArchitectureV5<512>));
             NnueCurrentArch = new(buffer) NnueArchitectureV5<512>;
             break;
         case NnueArchitectureV5<768>::networkfilesize:
-            buffer = (char*)allocalign64(sizeof(NnueArchitectureV5<768>));
+            buffer = (char*)my_large_malloc(sizeof(NnueArchitectureV5<768>));
             NnueCurrentArch = new(buffer) NnueArchitectureV5<768>;
             break;
         case NnueArchitectureV5<1024>::networkfilesize:
-            buffer = (char*)allocalign64(sizeof(NnueArchitectureV5<1024>));
+            buffer = (char*)my_large_malloc(sizeof(NnueArchitectureV5<1024>));
             NnueCurrentArch = new(buffer) NnueArchitectureV5<1024>;
             break;
         case NnueArchitectureV5<1536>::networkfilesize:
-            buffer = (char*)allocalign64(sizeof(NnueArchitectureV5<1536>));
+            buffer = (char*)my_large_malloc(sizeof(NnueArchitectureV5<1536>));
             NnueCurrentArch = new(buffer) NnueArchitectureV5<1536>;
             break;
         default:
             // We have a leb128 compressed feature transformer and don't know the input dimension yet but at least 1024
-            buffer = (char*)allocalign64(sizeof(NnueArchitectureV5<1024>));
+            buffer = (char*)my_large_malloc(sizeof(NnueArchitectureV5<1024>));
             NnueCurrentArch = new(buffer) NnueArchitectureV5<1024>;
             leb128dim = 1024;
             break;
@@ -2140,17 +2724,17 @@ bool NnueReadNet(NnueNetsource* nr)
         // Try the next dimension for leb128 compressed feature transformer
         switch (leb128dim) {
         case 1024:
-            buffer = (char*)allocalign64(sizeof(NnueArchitectureV5<1536>));
+            buffer = (char*)my_large_malloc(sizeof(NnueArchitectureV5<1536>));
             NnueCurrentArch = new(buffer) NnueArchitectureV5<1536>;
             leb128dim = 1536; // next dimensions to test
             break;
         case 1536:
-            buffer = (char*)allocalign64(sizeof(NnueArchitectureV5<2048>));
+            buffer = (char*)my_large_malloc(sizeof(NnueArchitectureV5<2048>));
             NnueCurrentArch = new(buffer) NnueArchitectureV5<2048>;
             leb128dim = 2048; // next dimensions to test
             break;
         case 2048:
-            buffer = (char*)allocalign64(sizeof(NnueArchitectureV5<2560>));
+            buffer = (char*)my_large_malloc(sizeof(NnueArchitectureV5<2560>));
             NnueCurrentArch = new(buffer) NnueArchitectureV5<2560>;
             leb128dim = 0; // no more dimensions to test
             break;
@@ -2228,6 +2812,213 @@ static int xFlate(bool compress, unsigned char* in, unsigned char** out, size_t
 }
 
 
+// The chunks of a compressed network are (de)compressed by the threads of the pool
+static struct {
+    bool compress;
+    vector<unsigned char*> in;
+    vector<size_t> insize;
+    vector<unsigned char*> out;
+    vector<size_t> outsize;
+    vector<int> ret;
+} zChunkJob;
+
+static void xFlateChunks(workingthread* thr)
+{
+    int threads = max(1, en.Threads);
+    for (size_t i = (thr ? thr->index : 0); i < zChunkJob.in.size(); i += threads)
+    {
+        uLongf outsize = (uLongf)zChunkJob.outsize[i];
+        zChunkJob.ret[i] = (zChunkJob.compress ? compress(zChunkJob.out[i], &outsize, zChunkJob.in[i], (uLong)zChunkJob.insize[i])
+            : uncompress(zChunkJob.out[i], &outsize, zChunkJob.in[i], (uLong)zChunkJob.insize[i]));
+        zChunkJob.outsize[i] = outsize;
+    }
+}
+
+static bool xFlateChunksParallel()
+{
+    size_t chunks = zChunkJob.in.size();
+    zChunkJob.ret.assign(chunks, Z_DATA_ERROR);
+    if (en.Threads < 2) {
+        xFlateChunks(nullptr);
+    }
+    else {
+        for (int i = 0; i < en.Threads; i++)
+            en.sthread[i].run_job(xFlateChunks);
+        for (int i = 0; i < en.Threads; i++)
+            en.sthread[i].wait_for_work_finished();
+    }
+
+    for (size_t i = 0; i < chunks; i++)
+        if (zChunkJob.ret[i] != Z_OK)
+            return false;
+    return true;
+}
+
+static bool isZChunked(unsigned char* in, size_t insize)
+{
+    return insize >= sizeof(NnueZChunkHeader) && memcmp(in, NNUEZCHUNKMAGIC, sizeof(NnueZChunkHeader::magic)) == 0;
+}
+
+// Compress the network to independent chunks
+static int deflateChunks(unsigned char* in, unsigned char** out, size_t insize, size_t* outsize)
+{
+    NnueZChunkHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, NNUEZCHUNKMAGIC, sizeof(header.magic));
+    header.chunks = (uint32_t)((insize + NNUEZCHUNKSIZE - 1) / NNUEZCHUNKSIZE);
+    header.chunksize = NNUEZCHUNKSIZE;
+    header.size = insize;
+
+    zChunkJob.compress = true;
+    zChunkJob.in.clear();
+    zChunkJob.insize.clear();
+    zChunkJob.out.clear();
+    zChunkJob.outsize.clear();
+    bool okay = true;
+    for (uint32_t i = 0; i < header.chunks; i++) {
+        size_t chunksize = min(insize - (size_t)i * NNUEZCHUNKSIZE, (size_t)NNUEZCHUNKSIZE);
+        zChunkJob.in.push_back(in + (size_t)i * NNUEZCHUNKSIZE);
+        zChunkJob.insize.push_back(chunksize);
+        zChunkJob.out.push_back((unsigned char*)malloc(compressBound((uLong)chunksize)));
+        zChunkJob.outsize.push_back(compressBound((uLong)chunksize));
+        okay = okay && zChunkJob.out[i];
+    }
+
+    okay = okay && xFlateChunksParallel();
+
+    *out = nullptr;
+    if (okay) {
+        *outsize = sizeof(header) + header.chunks * sizeof(uint64_t);
+        for (uint32_t i = 0; i < header.chunks; i++)
+            *outsize += zChunkJob.outsize[i];
+        *out = (unsigned char*)malloc(*outsize);
+        okay = (*out != nullptr);
+    }
+    if (okay) {
+        unsigned char* next = *out;
+        memcpy(next, &header, sizeof(header));
+        next += sizeof(header);
+        for (uint32_t i = 0; i < header.chunks; i++) {
+            uint64_t chunksize = zChunkJob.outsize[i];
+            memcpy(next, &chunksize, sizeof(uint64_t));
+            next += sizeof(uint64_t);
+        }
+        for (uint32_t i = 0; i < header.chunks; i++) {
+            memcpy(next, zChunkJob.out[i], zChunkJob.outsize[i]);
+            next += zChunkJob.outsize[i];
+        }
+    }
+
+    for (uint32_t i = 0; i < header.chunks; i++)
+        free(zChunkJob.out[i]);
+
+    return okay ? Z_OK : Z_MEM_ERROR;
+}
+
+// Inflate the independent chunks of a compressed network
+static int inflateChunks(unsigned char* in, unsigned char** out, size_t insize, size_t* outsize)
+{
+    NnueZChunkHeader header;
+    memcpy(&header, in, sizeof(header));
+    size_t offset = sizeof(header) + (size_t)header.chunks * sizeof(uint64_t);
+    *out = nullptr;
+    if (!header.chunksize || offset > insize || header.chunks != (header.size + header.chunksize - 1) / header.chunksize)
+        return Z_DATA_ERROR;
+
+    *out = (unsigned char*)malloc(header.size);
+    if (!*out)
+        return Z_MEM_ERROR;
+
+    zChunkJob.compress = false;
+    zChunkJob.in.clear();
+    zChunkJob.insize.clear();
+    zChunkJob.out.clear();
+    zChunkJob.outsize.clear();
+    vector<size_t> expectedsize;
+    for (uint32_t i = 0; i < header.chunks; i++) {
+        uint64_t chunksize;
+        memcpy(&chunksize, in + sizeof(header) + i * sizeof(uint64_t), sizeof(uint64_t));
+        if (chunksize > insize - offset)
+            return Z_DATA_ERROR;
+        expectedsize.push_back(min(header.size - (size_t)i * header.chunksize, (size_t)header.chunksize));
+        zChunkJob.in.push_back(in + offset);
+        zChunkJob.insize.push_back(chunksize);
+        zChunkJob.out.push_back(*out + (size_t)i * header.chunksize);
+        zChunkJob.outsize.push_back(expectedsize[i]);
+        offset += chunksize;
+    }
+
+    if (offset != insize || !xFlateChunksParallel() || zChunkJob.outsize != expectedsize)
+        return Z_DATA_ERROR;
+
+    *outsize = header.size;
+    return Z_OK;
+}
+
+
+// Write the network in native layout with aligned sections that can be mapped directly
+static void NnueWriteNativeNet(ofstream& os)
+{
+    NnueNativeHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, NNUENATIVEMAGIC, sizeof(header.magic));
+    header.nativeversion = NNUENATIVEVERSION;
+    header.fileversion = NnueCurrentArch->GetFileVersion();
+    uint32_t nethash = NnueCurrentArch->GetHash();
+    header.hash = NnueCurrentArch->GetFtHash() ^ nethash;
+    header.weightlayout = NnueCurrentArch->GetWeightLayout();
+    NnueCurrentArch->GetNativeLayout(&header);
+
+    // The weights of the network layers are written in the in-memory layout and in the usual format;
+    // the usual format stores one byte per weight and both are smaller than the whole network file
+    NnueNetsource nativenr;
+    nativenr.readbuffersize = NnueCurrentArch->GetNetworkFilesize() * sizeof(weight_t);
+    nativenr.readbuffer = (unsigned char*)allocalign64(nativenr.readbuffersize);
+    nativenr.next = nativenr.readbuffer;
+    NnueCurrentArch->WriteNativeWeights(&nativenr);
+    header.nativelayersize = nativenr.next - nativenr.readbuffer;
+
+    NnueNetsource nr;
+    nr.readbuffersize = NnueCurrentArch->GetNetworkFilesize();
+    nr.readbuffer = (unsigned char*)allocalign64(nr.readbuffersize);
+    nr.next = nr.readbuffer;
+    NnueCurrentArch->WriteWeights(&nr, nethash);
+    header.layeroffset = header.nativelayeroffset + MULTIPLEOFN(header.nativelayersize, 64);
+    header.layersize = nr.next - nr.readbuffer;
+
+    unsigned char* base = (unsigned char*)allocalign64(header.layeroffset + header.layersize);
+    memset(base, 0, header.layeroffset);
+    memcpy(base, &header, sizeof(header));
+    memcpy(base + header.biasoffset, NnueCurrentArch->GetFeatureBias(), header.ftdims * sizeof(int16_t));
+    memcpy(base + header.weightoffset, NnueCurrentArch->GetFeatureWeight(), (size_t)header.inputdims * header.ftdims * sizeof(int16_t));
+    if (header.psqtbuckets)
+        memcpy(base + header.psqtoffset, NnueCurrentArch->GetFeaturePsqtWeight(), (size_t)header.inputdims * header.psqtbuckets * sizeof(int32_t));
+    memcpy(base + header.nativelayeroffset, nativenr.readbuffer, header.nativelayersize);
+    memcpy(base + header.layeroffset, nr.readbuffer, header.layersize);
+
+    os.write((char*)base, header.layeroffset + header.layersize);
+
+    freealigned64(base);
+}
+
+
+// Replace the network file by the completely written temporary file. The file may be the mapped network of this
+// and other engine processes; unlike rewriting it in place this keeps their mappings valid.
+static bool NnueReplaceNetFile(string tmpname, string filename)
+{
+    if (rename(tmpname.c_str(), filename.c_str()) != 0) {
+        // rename doesn't replace an existing file on Windows
+        remove(filename.c_str());
+        if (rename(tmpname.c_str(), filename.c_str()) != 0) {
+            cout << "Cannot replace file " << filename << "\n";
+            remove(tmpname.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+
 void NnueWriteNet(vector<string> args)
 {
     size_t ci = 0;
@@ -2235,8 +3026,10 @@ void NnueWriteNet(vector<string> args)
     string NnueNetPath = "export.nnue";
     int rescale = 0;
     bool zExport = false;
+    bool zChunks = false;
     bool leb128 = false;
     bool sort = false;
+    bool native = false;
     if (ci < cs)
         NnueNetPath = args[ci++];
 
@@ -2247,8 +3040,13 @@ void NnueWriteNet(vector<string> args)
             leb128 = true;
         else if (args[ci] == "z")
             zExport = true;
+        else if (args[ci] == "zchunks")
+            // chunks that are compressed and decompressed in parallel; needs a binary that knows the format
+            zExport = zChunks = true;
         else if (args[ci] == "sort")
             sort = true;
+        else if (args[ci] == "native")
+            native = true;
         else
             cout << "Unknown parameter " << args[ci] << "\n";
         ci++;
@@ -2261,10 +3059,13 @@ void NnueWriteNet(vector<string> args)
         cout << "Cannot sort input features. This needs STATISTICS collection enabled.\n";
 #endif
 
+    string filename = NnueNetPath;
     ofstream os;
-    os.open(NnueNetPath, ios::binary);
-    if (!os && en.ExecPath != "")
-        os.open(en.ExecPath + NnueNetPath, ios::binary);
+    os.open(filename + ".tmp", ios::binary);
+    if (!os && en.ExecPath != "") {
+        filename = en.ExecPath + NnueNetPath;
+        os.open(filename + ".tmp", ios::binary);
+    }
 
     if (!os) {
         cout << "Cannot write file " << NnueNetPath << "\n";
@@ -2274,6 +3075,15 @@ void NnueWriteNet(vector<string> args)
     if (rescale)
         NnueCurrentArch->RescaleLastLayer(rescale);
 
+    if (native) {
+        NnueWriteNativeNet(os);
+        os.close();
+        if (!NnueReplaceNetFile(filename + ".tmp", filename))
+            return;
+        cout << "Network written to file " << NnueNetPath << " (native layout)\n";
+        return;
+    }
+
     uint32_t fthash = NnueCurrentArch->GetFtHash();
     uint32_t nethash = NnueCurrentArch->GetHash();
     uint32_t filehash = (fthash ^ nethash);
@@ -2300,19 +3110,24 @@ void NnueWriteNet(vector<string> args)
 
     unsigned char* deflatebuffer = nullptr;
     size_t deflatesize = 0;
+    unsigned char* outbuffer = nr.readbuffer;
     if (zExport) {
-        if (xFlate(true, nr.readbuffer, &deflatebuffer, insize, &deflatesize) == Z_OK) {
-            memcpy(nr.readbuffer, deflatebuffer, deflatesize);
+        int ret = (zChunks ? deflateChunks(nr.readbuffer, &deflatebuffer, insize, &deflatesize)
+            : xFlate(true, nr.readbuffer, &deflatebuffer, insize, &deflatesize));
+        if (ret == Z_OK) {
+            outbuffer = deflatebuffer;
             insize = deflatesize;
         }
         else {
             guiCom << "Cannot alloc buffer for compression.\n";
         }
-        free(deflatebuffer);
     }
 
-    os.write((char*)nr.readbuffer, insize);
+    os.write((char*)outbuffer, insize);
+    free(deflatebuffer);
     os.close();
+    if (!NnueReplaceNetFile(filename + ".tmp", filename))
+        return;
 
     cout << "Network written to file " << NnueNetPath << "\n";
 }
@@ -2320,6 +3135,7 @@ void NnueWriteNet(vector<string> args)
 
 bool NnueNetsource::open()
 {
+    U64 starttime = getTime();
     size_t insize = 0;
     bool openOk = false;
     vector<string> filenames;
@@ -2330,6 +3146,7 @@ bool NnueNetsource::open()
     int ret;
     unsigned char* inflatebuffer = nullptr;
     size_t inflatesize = 0;
+    string nativefilename;
 
 #ifdef NNUEINCLUDED
     inbuffer = (unsigned char*)&_binary_net_nnue_start;
@@ -2356,6 +3173,15 @@ bool NnueNetsource::open()
         if (!is)
             continue;
 
+        // Network files in native layout are mapped instead of read
+        char magic[sizeof(NnueNativeHeader::magic)];
+        if (is.read(magic, sizeof(magic)) && memcmp(magic, NNUENATIVEMAGIC, sizeof(magic)) == 0) {
+            nativefilename = filenames[i];
+            break;
+        }
+        is.clear();
+        is.seekg(0);
+
         struct stat stat_buf;
         if (stat(filenames[i].c_str(), &stat_buf) != 0) {
             guiCom << "info string Cannot get size of network file.\n";
@@ -2376,16 +3202,26 @@ bool NnueNetsource::open()
         if (insize > 0)
             break;
     }
-    if (!insize) {
+    if (!insize && nativefilename == "") {
         guiCom << "info string Cannot open file " << NnueNetPath << ". Probably doesn't exist.\n";
         goto cleanup;
     }
 #endif // NNUEINCLUDED
 
+    if (nativefilename != "" || (insize >= sizeof(NnueNativeHeader) && memcmp(inbuffer, NNUENATIVEMAGIC, sizeof(NnueNativeHeader::magic)) == 0)) {
+        openOk = NnueReadNativeNet(nativefilename, inbuffer, insize);
+        if (!openOk)
+            guiCom << "info string The network " + en.GetNnueNetPath() + " seems corrupted or format is not supported.\n";
+        else
+            guiCom << "info string Reading network " + en.GetNnueNetPath() + " successful (" + to_string((getTime() - starttime) * 1000 / en.frequency) + " ms). Using NNUE (" + NnueCurrentArch->GetArchName() + ", native layout).\n";
+        goto cleanup;
+    }
+
     sourcebuffer = inbuffer;
 
     // Now test if the input is compressed
-    ret = xFlate(false, inbuffer, &inflatebuffer, insize, &inflatesize);
+    ret = (isZChunked(inbuffer, insize) ? inflateChunks(inbuffer, &inflatebuffer, insize, &inflatesize)
+        : xFlate(false, inbuffer, &inflatebuffer, insize, &inflatesize));
     if (ret == Z_OK) {
         sourcebuffer = inflatebuffer;
         insize = inflatesize;
@@ -2406,7 +3242,7 @@ bool NnueNetsource::open()
     if (!openOk)
         guiCom << "info string The network " + en.GetNnueNetPath() + " seems corrupted or format is not supported.\n";
     else
-        guiCom << "info string Reading network " + en.GetNnueNetPath() + " successful. Using NNUE (" + NnueCurrentArch->GetArchName() + ").\n";
+        guiCom << "info string Reading network " + en.GetNnueNetPath() + " successful (" + to_string((getTime() - starttime) * 1000 / en.frequency) + " ms). Using NNUE (" + NnueCurrentArch->GetArchName() + ").\n";
 
 cleanup:
 #ifndef NNUEINCLUDED
@@ -125,7 +125,7 @@ inline int chessposition::getHistory(uint32_t code)
     int s2m = pc & S2MMASK;
     int from = GETFROM(code);
     int to = GETCORRECTTO(code);
-    int value = history[s2m][threatSquare][from][to];
+    int value = hst->history[s2m][threatSquare][from][to];
     int pieceTo = pc * 64 + to;
     value += (conthistptr[ply - 1][pieceTo] + conthistptr[ply - 2][pieceTo] + conthistptr[ply - 4][pieceTo]);
 
@@ -141,10 +141,10 @@ inline void chessposition::updateHistory(uint32_t code, int value)
     int to = GETCORRECTTO(code);
     value = max(-HISTORYMAXDEPTH * HISTORYMAXDEPTH, min(HISTORYMAXDEPTH * HISTORYMAXDEPTH, value));
 
-    int delta = value * (1 << HISTORYNEWSHIFT) - history[s2m][threatSquare][from][to] * abs(value) / (1 << HISTORYAGESHIFT);
-    myassert(history[s2m][threatSquare][from][to] + delta < MAXINT16 && history[s2m][threatSquare][from][to] + delta > MININT16, this, 2, history[s2m][from][to], delta);
+    int delta = value * (1 << HISTORYNEWSHIFT) - hst->history[s2m][threatSquare][from][to] * abs(value) / (1 << HISTORYAGESHIFT);
+    myassert(hst->history[s2m][threatSquare][from][to] + delta < MAXINT16 && hst->history[s2m][threatSquare][from][to] + delta > MININT16, this, 2, hst->history[s2m][from][to], delta);
 
-    history[s2m][threatSquare][from][to] += delta;
+    hst->history[s2m][threatSquare][from][to] += delta;
     int pieceTo = pc * 64 + to;
     const int maxplies = min(4, ply);
     for (int i : {0, 1, 3}) {
@@ -162,7 +162,7 @@ inline int chessposition::getTacticalHst(uint32_t code)
     int to = GETTO(code);
     int cp = GETCAPTURE(code) >> 1;
 
-    return tacticalhst[pt][to][cp];
+    return hst->tacticalhst[pt][to][cp];
 }
 
 
@@ -174,10 +174,10 @@ inline void chessposition::updateTacticalHst(uint32_t code, int value)
 
     value = max(-HISTORYMAXDEPTH * HISTORYMAXDEPTH, min(HISTORYMAXDEPTH * HISTORYMAXDEPTH, value));
 
-    int delta = value * (1 << HISTORYNEWSHIFT) - tacticalhst[pt][to][cp] * abs(value) / (1 << HISTORYAGESHIFT);
-    myassert(tacticalhst[pt][to][cp] + delta < MAXINT16 && tacticalhst[pt][to][cp] + delta > MININT16, this, 2, tacticalhst[pt][to][cp], delta);
+    int delta = value * (1 << HISTORYNEWSHIFT) - hst->tacticalhst[pt][to][cp] * abs(value) / (1 << HISTORYAGESHIFT);
+    myassert(hst->tacticalhst[pt][to][cp] + delta < MAXINT16 && hst->tacticalhst[pt][to][cp] + delta > MININT16, this, 2, hst->tacticalhst[pt][to][cp], delta);
 
-    tacticalhst[pt][to][cp] += delta;
+    hst->tacticalhst[pt][to][cp] += delta;
 }
 
 
@@ -190,20 +190,20 @@ inline void chessposition::updateCorrectionHst(int value, int depth)
     int weight = min(1 + depth, 16);
 
     index = pawnhash & (CORRHISTSIZE - 1);
-    pawncorrectionhistory[us][index] = max(-8192, min(8192,  (pawncorrectionhistory[us][index] * (256 - weight) + scaledvalue * weight) / 256));
+    hst->pawncorrectionhistory[us][index] = max(-8192, min(8192,  (hst->pawncorrectionhistory[us][index] * (256 - weight) + scaledvalue * weight) / 256));
     index = nonpawnhash[WHITE] & (CORRHISTSIZE - 1);
-    nonpawncorrectionhistory[WHITE][us][index] = max(-8192, min(8192, (nonpawncorrectionhistory[WHITE][us][index] * (256 - weight) + scaledvalue * weight) / 256));
+    hst->nonpawncorrectionhistory[WHITE][us][index] = max(-8192, min(8192, (hst->nonpawncorrectionhistory[WHITE][us][index] * (256 - weight) + scaledvalue * weight) / 256));
     index = nonpawnhash[BLACK] & (CORRHISTSIZE - 1);
-    nonpawncorrectionhistory[BLACK][us][index] = max(-8192, min(8192, (nonpawncorrectionhistory[BLACK][us][index] * (256 - weight) + scaledvalue * weight) / 256));
+    hst->nonpawncorrectionhistory[BLACK][us][index] = max(-8192, min(8192, (hst->nonpawncorrectionhistory[BLACK][us][index] * (256 - weight) + scaledvalue * weight) / 256));
 }
 
 inline int chessposition::correctEvalByHistory(int v)
 {
     int us = state & S2MMASK;
     int cv = v
-        + pawncorrectionhistory[us][pawnhash & (CORRHISTSIZE - 1)] / sps.pawncorrectionhistoryratio
-        + nonpawncorrectionhistory[WHITE][us][nonpawnhash[WHITE] & (CORRHISTSIZE - 1)] / sps.nonpawncorrectionhistoryratio
-        + nonpawncorrectionhistory[BLACK][us][nonpawnhash[BLACK] & (CORRHISTSIZE - 1)] / sps.nonpawncorrectionhistoryratio;
+        + hst->pawncorrectionhistory[us][pawnhash & (CORRHISTSIZE - 1)] / sps.pawncorrectionhistoryratio
+        + hst->nonpawncorrectionhistory[WHITE][us][nonpawnhash[WHITE] & (CORRHISTSIZE - 1)] / sps.nonpawncorrectionhistoryratio
+        + hst->nonpawncorrectionhistory[BLACK][us][nonpawnhash[BLACK] & (CORRHISTSIZE - 1)] / sps.nonpawncorrectionhistoryratio;
     return max(-SCORETBWININMAXPLY, min(cv, SCORETBWININMAXPLY));
 }
 
@@ -233,7 +233,7 @@ int chessposition::getQuiescence(int alpha, int beta, int depth)
 #endif
 
     // Reset pv
-    pvtable[ply][0] = 0;
+    sst->pvtable[ply][0] = 0;
 
 #ifdef SDEBUG
     uint16_t debugMove;
@@ -245,17 +245,18 @@ int chessposition::getQuiescence(int alpha, int beta, int depth)
     STATISTICSDO(if (depth < statistics.qs_mindepth) statistics.qs_mindepth = depth);
 
     bool tpHit;
-    ttentry* tte = tp.probeHash(hash, &tpHit);
-    int hashscore = tpHit ? FIXMATESCOREPROBE(tte->value, ply) : NOSCORE;
-    uint16_t hashmovecode = tpHit ? tte->movecode : 0;
+    ttentry tte;
+    ttslot tts = tp.probeHash(hash, &tpHit, &tte);
+    int hashscore = tpHit ? FIXMATESCOREPROBE(tte.value, ply) : NOSCORE;
+    uint16_t hashmovecode = tpHit ? tte.movecode : 0;
 
-    if (tpHit && !PVNode && hashscore != NOSCORE && (tte->boundAndAge & (hashscore >= beta ? HASHBETA : HASHALPHA)))
+    if (tpHit && !PVNode && hashscore != NOSCORE && (tte.boundAndAge & (hashscore >= beta ? HASHBETA : HASHALPHA)))
     {
         STATISTICSINC(qs_tt);
         return hashscore;
     }
 
-    int staticeval = tpHit ? tte->staticeval : NOSCORE;
+    int staticeval = tpHit ? tte.staticeval : NOSCORE;
 
     if (!myIsCheck)
     {
@@ -276,7 +277,7 @@ int chessposition::getQuiescence(int alpha, int beta, int depth)
         if (staticeval >= beta)
         {
             STATISTICSINC(qs_pat);
-            tp.addHash(tte, hash, staticeval, staticeval, HASHBETA, 0, hashmovecode);
+            tp.addHash(tts, hash, staticeval, staticeval, HASHBETA, 0, hashmovecode);
 
             return staticeval;
         }
@@ -294,7 +295,7 @@ int chessposition::getQuiescence(int alpha, int beta, int depth)
         if (Pt != NoPrune && bestExpectableScore < alpha)
         {
             STATISTICSINC(qs_delta);
-            tp.addHash(tte, hash, bestExpectableScore, staticeval, HASHALPHA, 0, hashmovecode);
+            tp.addHash(tts, hash, bestExpectableScore, staticeval, HASHALPHA, 0, hashmovecode);
             return staticeval;
         }
     }
@@ -336,7 +337,7 @@ int chessposition::getQuiescence(int alpha, int beta, int depth)
             if (score >= beta)
             {
                 STATISTICSINC(qs_moves_fh);
-                tp.addHash(tte, hash, score, staticeval, HASHBETA, 0, (uint16_t)bestcode);
+                tp.addHash(tts, hash, score, staticeval, HASHBETA, 0, (uint16_t)bestcode);
                 return score;
             }
             if (score > alpha)
@@ -359,7 +360,7 @@ int chessposition::getQuiescence(int alpha, int beta, int depth)
         // It's a mate
         return SCOREBLACKWINS + ply;
 
-    tp.addHash(tte, hash, alpha, staticeval, eval_type, 0, (uint16_t)bestcode);
+    tp.addHash(tts, hash, alpha, staticeval, eval_type, 0, (uint16_t)bestcode);
     return bestscore;
 }
 
@@ -380,7 +381,7 @@ int chessposition::alphabeta(int alpha, int beta, int depth, bool cutnode)
         return beta;
 
     // Reset pv
-    pvtable[ply][0] = 0;
+    sst->pvtable[ply][0] = 0;
 
     STATISTICSINC(ab_n);
     STATISTICSADD(ab_pv, PVNode);
@@ -458,12 +459,13 @@ int chessposition::alphabeta(int alpha, int beta, int depth, bool cutnode)
 
     // TT lookup
     bool tpHit;
-    ttentry* tte = tp.probeHash(newhash, &tpHit);
-    int hashscore = tpHit ? FIXMATESCOREPROBE(tte->value, ply) : NOSCORE;
-    uint16_t hashmovecode = tpHit ? tte->movecode : 0;
-    int rawstaticeval = tpHit ? tte->staticeval : NOSCORE;
+    ttentry tte;
+    ttslot tts = tp.probeHash(newhash, &tpHit, &tte);
+    int hashscore = tpHit ? FIXMATESCOREPROBE(tte.value, ply) : NOSCORE;
+    uint16_t hashmovecode = tpHit ? tte.movecode : 0;
+    int rawstaticeval = tpHit ? tte.staticeval : NOSCORE;
 
-    if (tpHit && !rep && !PVNode && FIXDEPTHFROMTT(tte->depth) >= depth && hashscore != NOSCORE && (tte->boundAndAge & (hashscore >= beta ? HASHBETA : HASHALPHA)))
+    if (tpHit && !rep && !PVNode && FIXDEPTHFROMTT(tte.depth) >= depth && hashscore != NOSCORE && (tte.boundAndAge & (hashscore >= beta ? HASHBETA : HASHALPHA)))
     {
         if (hashscore >= beta && hashmovecode && !mailbox[GETTO(hashmovecode)])
         {
@@ -509,7 +511,7 @@ int chessposition::alphabeta(int alpha, int beta, int depth, bool cutnode)
             }
             if (bound == HASHEXACT || (bound == HASHALPHA ? (score <= alpha) : (score >= beta)))
             {
-                tp.addHash(tte, hash, score, rawstaticeval, bound, MAXDEPTH - 1, 0);
+                tp.addHash(tts, hash, score, rawstaticeval, bound, MAXDEPTH - 1, 0);
                 return score;
             }
 
@@ -544,7 +546,7 @@ int chessposition::alphabeta(int alpha, int beta, int depth, bool cutnode)
     if (rawstaticeval == NOSCORE)
     {
         rawstaticeval = getEval<NOTRACE>();
-        tp.addHash(tte, hash, rawstaticeval, rawstaticeval, HASHUNKNOWN, 0, hashmovecode);
+        tp.addHash(tts, hash, rawstaticeval, rawstaticeval, HASHUNKNOWN, 0, hashmovecode);
     }
     int staticeval = correctEvalByHistory(rawstaticeval);
     staticevalstack[ply] = staticeval;
@@ -655,7 +657,7 @@ int chessposition::alphabeta(int alpha, int beta, int depth, bool cutnode)
                     // ProbCut off
                     STATISTICSINC(prune_probcut);
                     SDEBUGDO(isDebugPv, pvabortscore[ply] = probcutscore; pvaborttype[ply] = PVA_PROBCUTPRUNED; pvadditionalinfo[ply] = "pruned by " + moveToString(mc););
-                    tp.addHash(tte, hash, probcutscore, rawstaticeval, HASHBETA, depth - 3, mc);
+                    tp.addHash(tts, hash, probcutscore, rawstaticeval, HASHBETA, depth - 3, mc);
                     return probcutscore;
                 }
             }
@@ -674,7 +676,7 @@ int chessposition::alphabeta(int alpha, int beta, int depth, bool cutnode)
     uint32_t lastmove = movecode[ply - 1];
     uint32_t counter = 0;
     if (lastmove)
-        counter = countermove[GETPIECE(lastmove)][GETCORRECTTO(lastmove)];
+        counter = hst->countermove[GETPIECE(lastmove)][GETCORRECTTO(lastmove)];
 
     // Reset killers for child ply
     killer[ply + 1][0] = killer[ply + 1][1] = 0;
@@ -741,6 +743,7 @@ int chessposition::alphabeta(int alpha, int beta, int depth, bool cutnode)
 
         int stats = !ISTACTICAL(mc) ? getHistory(mc) : getTacticalHst(mc);
         int extendMove = 0;
+        ttentry ttlive;
 
         if (Pt != MatePrune)
         {
@@ -748,8 +751,10 @@ int chessposition::alphabeta(int alpha, int beta, int depth, bool cutnode)
             if ((mc & 0xffff) == hashmovecode
                 && depth >= sps.singularmindepth
                 && !excludeMove
-                && (tte->boundAndAge & HASHBETA)
-                && FIXDEPTHFROMTT(tte->depth) >= depth - 3
+                // test the live slot as it may have been updated since the probe (static eval, ProbCut, child nodes)
+                && tts.load(newhash, &ttlive)
+                && (ttlive.boundAndAge & HASHBETA)
+                && FIXDEPTHFROMTT(ttlive.depth) >= depth - 3
 #ifdef NNUELEARN
                 // No singular extension in root of gensfen
                 && ply > 0
@@ -923,7 +928,7 @@ int chessposition::alphabeta(int alpha, int beta, int depth, bool cutnode)
                     {
                         updateHistory(mc, depth * depth);
                         for (int i = 0; i < quietsPlayed; i++)
-                            updateHistory(quietMoves[ply][i], -(depth * depth));
+                            updateHistory(sst->quietMoves[ply][i], -(depth * depth));
 
                         // Killermove
                         if (killer[ply][0] != mc)
@@ -934,13 +939,13 @@ int chessposition::alphabeta(int alpha, int beta, int depth, bool cutnode)
 
                         // save countermove
                         if (lastmove)
-                            countermove[GETPIECE(lastmove)][GETCORRECTTO(lastmove)] = mc;
+                            hst->countermove[GETPIECE(lastmove)][GETCORRECTTO(lastmove)] = mc;
                     }
                     else
                     {
                         updateTacticalHst(mc, depth * depth);
                         for (int i = 0; i < tacticalPlayed; i++)
-                            updateTacticalHst(tacticalMoves[ply][i], -(depth * depth));
+                            updateTacticalHst(sst->tacticalMoves[ply][i], -(depth * depth));
                     }
 
                     failhighcount[ply] += (!hashmovecode + 1);
@@ -952,7 +957,7 @@ int chessposition::alphabeta(int alpha, int beta, int depth, bool cutnode)
                         if (!ISCAPTURE(bestcode) && !isCheckbb && !(bestscore < staticeval))
                             updateCorrectionHst(bestscore - staticeval, depth);
 
-                        tp.addHash(tte, newhash, FIXMATESCOREADD(score, ply), rawstaticeval, HASHBETA, depth, (uint16_t)bestcode);
+                        tp.addHash(tts, newhash, FIXMATESCOREADD(score, ply), rawstaticeval, HASHBETA, depth, (uint16_t)bestcode);
                     }
 
                     SDEBUGDO(isDebugPv, pvaborttype[ply] = isDebugMove ? PVA_BETACUT : debugMovePlayed ? PVA_NOTBESTMOVE : PVA_OMITTED;);
@@ -967,9 +972,9 @@ int chessposition::alphabeta(int alpha, int beta, int depth, bool cutnode)
         }
 
         if (!ISTACTICAL(mc))
-            quietMoves[ply][quietsPlayed++] = mc;
+            sst->quietMoves[ply][quietsPlayed++] = mc;
         else
-            tacticalMoves[ply][tacticalPlayed++] = mc;
+            sst->tacticalMoves[ply][tacticalPlayed++] = mc;
     }
 
     if (legalMoves == 0)
@@ -995,7 +1000,7 @@ int chessposition::alphabeta(int alpha, int beta, int depth, bool cutnode)
         if (!ISCAPTURE(bestcode) && !isCheckbb && !(eval_type == HASHALPHA && bestscore > staticeval))
             updateCorrectionHst(bestscore - staticeval, depth);
 
-        tp.addHash(tte, newhash, FIXMATESCOREADD(bestscore, ply), rawstaticeval, eval_type, depth, (uint16_t)bestcode);
+        tp.addHash(tts, newhash, FIXMATESCOREADD(bestscore, ply), rawstaticeval, eval_type, depth, (uint16_t)bestcode);
         SDEBUGDO(isDebugPv || debugTransposition, tp.debugSetPv(newhash, movesOnStack() + " " + (debugTransposition ? "(transposition)" : "") + " depth=" + to_string(depth)););
     }
 
@@ -1016,7 +1021,7 @@ int chessposition::rootsearch(int alpha, int beta, int depth, int inWindowLast,
     const bool isMultiPV = (RT == MultiPVSearch);
 
     // reset pv
-    pvtable[0][0] = 0;
+    sst->pvtable[0][0] = 0;
 
     if (isMultiPV)
     {
@@ -1033,17 +1038,18 @@ int chessposition::rootsearch(int alpha, int beta, int depth, int inWindowLast,
 
     bool tpHit;
     int newDepth;
-    ttentry* tte = tp.probeHash(hash, &tpHit);
-    int score = tpHit ? tte->value : NOSCORE;
-    uint16_t hashmovecode = tpHit ? tte->movecode : 0;
-    int staticeval = tpHit ? tte->staticeval : NOSCORE;
+    ttentry tte;
+    ttslot tts = tp.probeHash(hash, &tpHit, &tte);
+    int score = tpHit ? tte.value : NOSCORE;
+    uint16_t hashmovecode = tpHit ? tte.movecode : 0;
+    int staticeval = tpHit ? tte.staticeval : NOSCORE;
 
     if (!isMultiPV
         && !useRootmoveScore
         && tpHit
-        && (newDepth = FIXDEPTHFROMTT(tte->depth)) >= depth
+        && (newDepth = FIXDEPTHFROMTT(tte.depth)) >= depth
         && score != NOSCORE
-        && (tte->boundAndAge & BOUNDMASK) == HASHEXACT)
+        && (tte.boundAndAge & BOUNDMASK) == HASHEXACT)
     {
         // Hash is fixed regarding scores that don't see actual 3folds so we can trust the entry
         uint32_t fullhashmove = shortMove2FullMove(hashmovecode);
@@ -1081,11 +1087,11 @@ int chessposition::rootsearch(int alpha, int beta, int depth, int inWindowLast,
             else if (GETCAPTURE(m->code) != BLANK)
                 m->value = (m->code & BADSEEFLAG ? -1 : 1) * (mvv[GETCAPTURE(m->code) >> 1] | lva[GETPIECE(m->code) >> 1]);
             else
-                m->value = history[state & S2MMASK][threatSquare][GETFROM(m->code)][GETCORRECTTO(m->code)];
+                m->value = hst->history[state & S2MMASK][threatSquare][GETFROM(m->code)][GETCORRECTTO(m->code)];
             if (isMultiPV) {
-                if (multipvtable[0][0] == m->code)
+                if (sst->multipvtable[0][0] == m->code)
                     m->value = PVVAL;
-                if (multipvtable[1][0] == m->code)
+                if (sst->multipvtable[1][0] == m->code)
                     m->value = PVVAL - 1;
             }
         }
@@ -1095,7 +1101,7 @@ int chessposition::rootsearch(int alpha, int beta, int depth, int inWindowLast,
     {
         for (int i = 0; i < maxmoveindex; i++)
         {
-            multipvtable[i][0] = 0;
+            sst->multipvtable[i][0] = 0;
             bestmovescore[i] = NOSCORE;
         }
     }
@@ -1170,16 +1176,16 @@ int chessposition::rootsearch(int alpha, int beta, int depth, int inWindowLast,
 
         unplayMove<false>(m->code);
 
-        nodespermove[(uint16_t)m->code] += nodes - nodesbeforemove;
+        sst->nodespermove[(uint16_t)m->code] += nodes - nodesbeforemove;
 
         if (en.stopLevel == ENGINESTOPIMMEDIATELY)
             // time is over; immediate stop requested
             return bestscore;
 
         if (!ISTACTICAL(m->code))
-            quietMoves[0][quietsPlayed++] = m->code;
+            sst->quietMoves[0][quietsPlayed++] = m->code;
         else
-            tacticalMoves[0][tacticalPlayed++] = m->code;
+            sst->tacticalMoves[0][tacticalPlayed++] = m->code;
 
         if ((isMultiPV && score <= bestmovescore[lastmoveindex])
             || (!isMultiPV && score <= bestscore))
@@ -1199,11 +1205,11 @@ int chessposition::rootsearch(int alpha, int beta, int depth, int inWindowLast,
                 while (newindex > 0 && score > bestmovescore[newindex - 1])
                 {
                     bestmovescore[newindex] = bestmovescore[newindex - 1];
-                    uint32_t *srctable = (newindex - 1 ? multipvtable[newindex - 1] : pvtable[0]);
+                    uint32_t *srctable = (newindex - 1 ? sst->multipvtable[newindex - 1] : sst->pvtable[0]);
                     int j = 0;
                     while (true)
                     {
-                        multipvtable[newindex][j] = srctable[j];
+                        sst->multipvtable[newindex][j] = srctable[j];
                         if (!srctable[j])
                             break;
                         j++;
@@ -1235,14 +1241,14 @@ int chessposition::rootsearch(int alpha, int beta, int depth, int inWindowLast,
         if (score > alpha)
         {
             SDEBUGDO(isDebugPv, pvaborttype[0] = isDebugMove ? PVA_BESTMOVE : debugMovePlayed ? PVA_NOTBESTMOVE : PVA_OMITTED;);
-            if (bestmove != pvtable[0][0])
+            if (bestmove != sst->pvtable[0][0])
             {
-                bestmove = pvtable[0][0];
-                pondermove = pvtable[0][1];
+                bestmove = sst->pvtable[0][0];
+                pondermove = sst->pvtable[0][1];
             }
-            else if (pvtable[0][1]) {
+            else if (sst->pvtable[0][1]) {
                 // use new ponder move
-                pondermove = pvtable[0][1];
+                pondermove = sst->pvtable[0][1];
             }
             if (!isMultiPV)
             {
@@ -1257,7 +1263,7 @@ int chessposition::rootsearch(int alpha, int beta, int depth, int inWindowLast,
                 {
                     updateHistory(m->code, depth * depth);
                     for (int q = 0; q < quietsPlayed - 1; q++)
-                        updateHistory(quietMoves[0][q], -(depth * depth));
+                        updateHistory(sst->quietMoves[0][q], -(depth * depth));
 
                     if (killer[0][0] != m->code)
                     {
@@ -1269,10 +1275,10 @@ int chessposition::rootsearch(int alpha, int beta, int depth, int inWindowLast,
                 {
                     updateTacticalHst(m->code, depth * depth);
                     for (int t = 0; t < tacticalPlayed - 1; t++)
-                        updateTacticalHst(tacticalMoves[0][t], -(depth * depth));
+                        updateTacticalHst(sst->tacticalMoves[0][t], -(depth * depth));
 
                 }
-                tp.addHash(tte, hash, beta, staticeval, HASHBETA, depth, (uint16_t)m->code);
+                tp.addHash(tts, hash, beta, staticeval, HASHBETA, depth, (uint16_t)m->code);
                 SDEBUGDO(isDebugPv, pvaborttype[0] = isDebugMove ? PVA_BETACUT : debugMovePlayed ? PVA_NOTBESTMOVE : PVA_OMITTED;);
                 SDEBUGDO(isDebugPv, tp.debugSetPv(hash, movesOnStack() + " effectiveDepth=" + to_string(effectiveDepth)););
                 return beta;   // fail hard beta-cutoff
@@ -1286,7 +1292,7 @@ int chessposition::rootsearch(int alpha, int beta, int depth, int inWindowLast,
         }
     }
 
-    tp.addHash(tte, hash, alpha, staticeval, eval_type, depth, (uint16_t)bestmove);
+    tp.addHash(tts, hash, alpha, staticeval, eval_type, depth, (uint16_t)bestmove);
     SDEBUGDO(isDebugPv, tp.debugSetPv(hash, movesOnStack() + " depth=" + to_string(depth)););
 
     return alpha;
@@ -1309,7 +1315,7 @@ static void uciScore(workingthread *thr, int inWindow, U64 thinktime, int score,
     const string boundscore[] = { "upperbound ", "", "lowerbound " };
     chessposition *pos = thr->pos;
 
-    string pvstring = pos->getPv(mpvIndex ? pos->multipvtable[mpvIndex] : pos->lastpv);
+    string pvstring = pos->getPv(mpvIndex ? pos->sst->multipvtable[mpvIndex] : pos->lastpv);
     U64 nodes, tbhits;
     en.getNodesAndTbhits(&nodes, &tbhits);
 
@@ -1448,13 +1454,13 @@ void mainSearch(workingthread *thr)
         if (en.maxnodes && !en.LimitNps && pos->nodes >= en.maxnodes)
             break;
 
-        if (pos->pvtable[0][0])
+        if (pos->sst->pvtable[0][0])
         {
             // copy new pv to lastpv
             int i = 0;
-            while (pos->pvtable[0][i])
+            while (pos->sst->pvtable[0][i])
             {
-                pos->lastpv[i] = pos->pvtable[0][i];
+                pos->lastpv[i] = pos->sst->pvtable[0][i];
                 i++;
                 if (i == MAXDEPTH - 1) break;
             }
@@ -1491,10 +1497,11 @@ void mainSearch(workingthread *thr)
                 if (!pos->bestmove)
                 {
                     bool tpHit;
-                    ttentry* tte = tp.probeHash(pos->hash, &tpHit);
+                    ttentry tte;
+                    tp.probeHash(pos->hash, &tpHit, &tte);
                     if (tpHit)
                     {
-                        pos->bestmove = pos->shortMove2FullMove(tte->movecode);
+                        pos->bestmove = pos->shortMove2FullMove(tte.movecode);
                         pos->pondermove = 0;
                     }
                 }
@@ -1551,7 +1558,7 @@ void mainSearch(workingthread *thr)
             if (en.tmEnabled && (inWindow == 1 || !constantRootMoves))
             {
                 // Recalculate remaining time for next depth
-                int bestmovenodesratio = pos->nodes ? (int)(128 * (2.5 -  2 * (double)pos->nodespermove[(uint16_t)pos->bestmove] / pos->nodes)) : 128;
+                int bestmovenodesratio = pos->nodes ? (int)(128 * (2.5 -  2 * (double)pos->sst->nodespermove[(uint16_t)pos->bestmove] / pos->nodes)) : 128;
                 en.resetEndTime(nowtime, constantRootMoves, bestmovenodesratio);
             }
 
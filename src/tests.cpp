@@ -28,7 +28,7 @@ void perftjob(workingthread* thr)
     chessposition* pos = thr->pos;
     if (thr->lastCompleteDepth & 1)
     {
-        memcpy((void*)pos, thr->rootpos, offsetof(chessposition, history));
+        memcpy((void*)pos, thr->rootpos, offsetof(chessposition, hst));
         thr->lastCompleteDepth ^= 1;
         pos->tbhits = 0;
     }
@@ -44,11 +44,8 @@ void perftjob(workingthread* thr)
         ml->length = startmove + 1;
     }
     else {
-        ml = &pos->quietslist[pos->ply];
-        if (pos->isCheckbb)
-            ml->length = pos->CreateEvasionMovelist(&ml->move[0]);
-        else
-            ml->length = pos->CreateMovelist<ALL>(&ml->move[0]);
+        ml = &pos->sst->quietslist[pos->ply];
+        ml->length = pos->CreateMovelist<LEGALALL>(&ml->move[0]);
     }
 
     if (startmove >= ml->length)
@@ -81,7 +78,194 @@ void perftjob(workingthread* thr)
     }
 }
 
-U64 engine::perft(int depth, bool printsysteminfo)
+
+// Fast perft: bulk counting of the legal moves at the last ply, perft hash keyed by (hash, depth)
+// and a queue of jobs split some plies below the root so that all threads have work until the end
+#define PERFTMAXSPLITPLIES 3
+#define PERFTHASHKEY(h, d) ((h) ^ ((U64)(d) * 0x9e3779b97f4a7c15ULL))
+
+struct perfthashentry
+{
+    atomic<U64> key;    // xor'ed with nodes to detect entries torn by concurrent writes
+    atomic<U64> nodes;
+};
+
+struct perftjobentry
+{
+    uint32_t movecode[PERFTMAXSPLITPLIES];
+    int rootindex;
+    U64 nodes;
+};
+
+static struct {
+    vector<perftjobentry> jobs;
+    vector<uint32_t> rootmoves;
+    atomic<int> nextjob;
+    int splitplies;
+    int depth;          // depth left for the jobs
+    perfthashentry* table;
+    U64 sizemask;
+} perftqueue;
+
+
+static U64 perftfast(chessposition* pos, int depth)
+{
+    if (depth == 0)
+        return 1;
+
+    perfthashentry* e = nullptr;
+    U64 key = PERFTHASHKEY(pos->hash, depth);
+    if (depth > 1 && perftqueue.table)
+    {
+        e = &perftqueue.table[key & perftqueue.sizemask];
+        U64 nodes = e->nodes.load(memory_order_relaxed);
+        if ((e->key.load(memory_order_relaxed) ^ nodes) == key)
+            return nodes;
+    }
+
+    pos->prepareStack();
+    chessmovelist* ml = &pos->sst->quietslist[pos->ply];
+    if (pos->isCheckbb)
+        ml->length = pos->CreateEvasionMovelist(&ml->move[0]);
+    else
+        ml->length = pos->CreateMovelist<ALL>(&ml->move[0]);
+
+    U64 nodes = 0;
+    for (int i = 0; i < ml->length; i++)
+    {
+        uint32_t mc = ml->move[i].code;
+        if (depth == 1)
+        {
+            nodes += pos->moveIsLegal(mc);
+        }
+        else if (pos->playMove<false>(mc))
+        {
+            nodes += perftfast(pos, depth - 1);
+            pos->unplayMove<false>(mc);
+        }
+    }
+
+    if (e)
+    {
+        e->nodes.store(nodes, memory_order_relaxed);
+        e->key.store(key ^ nodes, memory_order_relaxed);
+    }
+
+    return nodes;
+}
+
+
+static void perftcollectjobs(chessposition* pos, int plies, perftjobentry* job)
+{
+    pos->prepareStack();
+    chessmovelist ml;
+    if (pos->isCheckbb)
+        ml.length = pos->CreateEvasionMovelist(&ml.move[0]);
+    else
+        ml.length = pos->CreateMovelist<ALL>(&ml.move[0]);
+
+    for (int i = 0; i < ml.length; i++)
+    {
+        uint32_t mc = ml.move[i].code;
+        if (!pos->playMove<false>(mc))
+            continue;
+        job->movecode[pos->ply - 1] = mc;
+        if (pos->ply == 1)
+        {
+            job->rootindex = (int)perftqueue.rootmoves.size();
+            perftqueue.rootmoves.push_back(mc);
+        }
+        if (plies > 1)
+            perftcollectjobs(pos, plies - 1, job);
+        else
+            perftqueue.jobs.push_back(*job);
+        pos->unplayMove<false>(mc);
+    }
+}
+
+
+static void perftqueuejob(workingthread* thr)
+{
+    chessposition* pos = thr->pos;
+    memcpy((void*)pos, thr->rootpos, offsetof(chessposition, hst));
+
+    int i;
+    while ((i = perftqueue.nextjob++) < (int)perftqueue.jobs.size())
+    {
+        perftjobentry* job = &perftqueue.jobs[i];
+        for (int j = 0; j < perftqueue.splitplies; j++)
+        {
+            pos->prepareStack();
+            pos->playMove<false>(job->movecode[j]);
+        }
+        job->nodes = perftfast(pos, perftqueue.depth);
+        for (int j = perftqueue.splitplies - 1; j >= 0; j--)
+            pos->unplayMove<false>(job->movecode[j]);
+    }
+}
+
+
+static U64 perftwithqueue(int depth, bool printsysteminfo)
+{
+    chessposition* rootpos = &en.rootposition;
+    perftjobentry job;
+
+    // split deep enough for some jobs per thread but keep the hash useful for the remaining depth
+    perftqueue.splitplies = max(1, min(PERFTMAXSPLITPLIES, depth - 3));
+    perftqueue.depth = depth - perftqueue.splitplies;
+    perftqueue.jobs.clear();
+    perftqueue.rootmoves.clear();
+    perftqueue.nextjob = 0;
+    perftcollectjobs(rootpos, perftqueue.splitplies, &job);
+
+    perftqueue.table = nullptr;
+    U64 size = ((U64)en.Hash << 20) / sizeof(perfthashentry);
+    if (perftqueue.depth > 1 && size)
+    {
+        int msb;
+        GETMSB(msb, size);
+        size = 1ULL << msb;
+        perftqueue.table = (perfthashentry*)allocalign64(size * sizeof(perfthashentry));
+        if (perftqueue.table)
+        {
+            memset((void*)perftqueue.table, 0, size * sizeof(perfthashentry));
+            perftqueue.sizemask = size - 1;
+        }
+    }
+
+    int threads = min(en.Threads, (int)perftqueue.jobs.size());
+    for (int i = 0; i < threads; i++)
+    {
+        en.sthread[i].wait_for_work_finished();
+        en.sthread[i].run_job(perftqueuejob);
+    }
+    for (int i = 0; i < threads; i++)
+        en.sthread[i].wait_for_work_finished();
+
+    freealigned64(perftqueue.table);
+    perftqueue.table = nullptr;
+
+    vector<U64> rootnodes(perftqueue.rootmoves.size(), 0);
+    for (auto& j : perftqueue.jobs)
+        rootnodes[j.rootindex] += j.nodes;
+
+    U64 retval = 0;
+    for (size_t i = 0; i < rootnodes.size(); i++)
+    {
+        if (printsysteminfo)
+        {
+            stringstream ss;
+            ss << setw(5) << left << moveToString(perftqueue.rootmoves[i]) << ": " << rootnodes[i] << "\n";
+            guiCom << ss.str();
+        }
+        retval += rootnodes[i];
+    }
+
+    return retval;
+}
+
+
+U64 engine::perft(int depth, bool printsysteminfo, bool fast)
 {
     long long starttime = 0;
     long long endtime = 0;
@@ -90,38 +274,45 @@ U64 engine::perft(int depth, bool printsysteminfo)
 
     if (printsysteminfo) {
         starttime = getTime();
-        guiCom << "Perft for depth " + to_string(maxdepth) + (en.chess960 ? "  Chess960" : "") + "\n";
+        guiCom << "Perft for depth " + to_string(maxdepth) + " (" MAKEUNMAKESTR + (fast ? ", bulk counting, hash, split queue" : "") + ")" + (en.chess960 ? "  Chess960" : "") + "\n";
     }
 
-    rootpos->rootmovelist.length = rootpos->CreateMovelist<ALL>(&rootpos->rootmovelist.move[0]);
-
-    for (int i = 0; i < en.Threads; i++)
-        // write "position needs init" and print flag to the thread
-        sthread[i].lastCompleteDepth = 1 + 2 * printsysteminfo;
-
-    int tnum = 0;
-    for (int i = 0; i < rootpos->rootmovelist.length; i++)
+    if (fast)
     {
+        retval = perftwithqueue(depth, printsysteminfo);
+    }
+    else
+    {
+        rootpos->rootmovelist.length = rootpos->CreateMovelist<LEGALALL>(&rootpos->rootmovelist.move[0]);
+
+        for (int i = 0; i < en.Threads; i++)
+            // write "position needs init" and print flag to the thread
+            sthread[i].lastCompleteDepth = 1 + 2 * printsysteminfo;
 
-        workingthread* wt;
-        while ((wt = &sthread[tnum]) && en.Threads > 1 && wt->working)
+        int tnum = 0;
+        for (int i = 0; i < rootpos->rootmovelist.length; i++)
         {
+
+            workingthread* wt;
+            while ((wt = &sthread[tnum]) && en.Threads > 1 && wt->working)
+            {
+                tnum = (tnum + 1) % en.Threads;
+                if (depth > 4 && tnum == 0)
+                    Sleep(1);
+                continue;
+            }
+            wt->wait_for_work_finished();
+            wt->index = i;
+            wt->depth = depth;
+            wt->run_job(perftjob);
             tnum = (tnum + 1) % en.Threads;
-            if (depth > 4 && tnum == 0)
-                Sleep(1);
-            continue;
         }
-        wt->wait_for_work_finished();
-        wt->index = i;
-        wt->depth = depth;
-        wt->run_job(perftjob);
-        tnum = (tnum + 1) % en.Threads;
-    }
-    for (int i = 0; i < min(en.Threads, rootpos->rootmovelist.length); i++)
-    {
-        workingthread* wt = &sthread[i];
-        wt->wait_for_work_finished();
-        retval += wt->pos->tbhits;
+        for (int i = 0; i < min(en.Threads, rootpos->rootmovelist.length); i++)
+        {
+            workingthread* wt = &sthread[i];
+            wt->wait_for_work_finished();
+            retval += wt->pos->tbhits;
+        }
     }
 
     if (printsysteminfo) {
@@ -135,7 +326,7 @@ U64 engine::perft(int depth, bool printsysteminfo)
     return retval;
 }
 
-void perftest(int maxdepth)
+void perftest(int maxdepth, bool fast)
 {
     struct perftestresultstruct
     {
@@ -205,7 +396,7 @@ void perftest(int maxdepth)
     int i = 0;
     char str[256];
 
-    guiCom << "Perft for depth " + to_string(maxdepth) + (en.chess960 ? "  Chess960" : "") + "\n";
+    guiCom << "Perft for depth " + to_string(maxdepth) + " (" MAKEUNMAKESTR + (fast ? ", bulk counting, hash, split queue" : "") + ")" + (en.chess960 ? "  Chess960" : "") + "\n";
 
     float df;
     U64 totalresult = 0ULL;
@@ -227,7 +418,7 @@ void perftest(int maxdepth)
         {
             long long starttime = getTime();
 
-            U64 result = en.perft(j);
+            U64 result = en.perft(j, false, fast);
             totalresult += result;
 
             perftlasttime = getTime();
@@ -843,6 +1034,252 @@ void speedtest(int threads, int hash, int time)
     en.ucioptions.Set("Hash", to_string(oldHash));
 }
 
+
+// Hashed tree walk for the tt speedtest; subtrees already walked to the same depth are cut like in the search
+template <class T>
+static U64 ttspeedwalk(T* tt, chessposition* pos, int depth, U64* hits)
+{
+    bool found;
+    ttentry e;
+    ttslot slot = tt->probeHash(pos->hash, &found, &e);
+    if (found)
+    {
+        (*hits)++;
+        if (FIXDEPTHFROMTT(e.depth) >= depth)
+            return 1;
+    }
+
+    pos->prepareStack();
+    chessmovelist* ml = &pos->sst->quietslist[pos->ply];
+    if (pos->isCheckbb)
+        ml->length = pos->CreateEvasionMovelist(&ml->move[0]);
+    else
+        ml->length = pos->CreateMovelist<ALL>(&ml->move[0]);
+
+    U64 nodes = 1;
+    uint16_t firstmove = 0;
+    for (int i = 0; i < ml->length; i++)
+    {
+        uint32_t mc = ml->move[i].code;
+        if (pos->playMove<false>(mc))
+        {
+            if (!firstmove)
+                firstmove = (uint16_t)mc;
+            nodes += (depth > 1 ? ttspeedwalk(tt, pos, depth - 1, hits) : 1);
+            pos->unplayMove<false>(mc);
+        }
+    }
+    tt->addHash(slot, pos->hash, 0, 0, HASHEXACT, depth, firstmove);
+
+    return nodes;
+}
+
+template <int Entries, int Bytes>
+static void ttspeedrun(int hash, int depth)
+{
+    transpositiontable<transpositioncluster<Entries, Bytes>> tt;
+    int sizeMb = hash;
+    tt.setSize(&sizeMb);
+    chessposition* pos = en.sthread[0].pos;
+    U64 nodes = 0, hits = 0;
+    U64 startTime = getTime();
+    for (const auto& game : BenchmarkPositions)
+    {
+        for (size_t i = 0; i < game.size(); i += 16)
+        {
+            pos->getFromFen(game[i].c_str());
+            tt.nextSearch();
+            nodes += ttspeedwalk(&tt, pos, depth, &hits);
+        }
+    }
+    U64 testTime = (getTime() - startTime) * 1000 / en.frequency;
+
+    cout << setw(2) << Entries << " x 10 in " << setw(2) << Bytes << " bytes : "
+        << setw(12) << nodes << " nodes  " << setw(10) << hits << " hits  " << setw(8) << testTime << " ms  "
+        << setw(10) << (long long)(nodes * 1000 / max(testTime, (U64)1)) << " nps  hashfull " << tt.getUsedinPermill() << endl;
+}
+
+// Compare the tt cluster layouts on the same hashed tree walk; less nodes means better replacement
+void ttspeedtest(int hash, int depth)
+{
+    if (!hash)
+        hash = DEFAULTHASH;
+    if (!depth)
+        depth = 4;
+
+    cout << "TT layout speedtest with " << hash << " MiB, depth " << depth << "\n";
+    ttspeedrun<3, 32>(hash, depth);
+    ttspeedrun<6, 64>(hash, depth);
+}
+
+// Position with its own accumulators for evaluation without search
+static chessposition* allocNnuePosition()
+{
+    chessposition* pos = new(allocalign64(sizeof(chessposition))) chessposition;
+    pos->accumulation = NnueCurrentArch->CreateAccumulationStack();
+    pos->psqtAccumulation = NnueCurrentArch->CreatePsqtAccumulationStack();
+    NnueCurrentArch->CreateAccumulationCache(pos);
+    NnueCurrentArch->ResetAccumulationCache(pos);
+    return pos;
+}
+
+static void freeNnuePosition(chessposition* pos)
+{
+    freealigned64(pos->accumulation);
+    freealigned64(pos->psqtAccumulation);
+    freealigned64(pos->accucache.accumulation);
+    if (pos->accucache.psqtaccumulation)
+        freealigned64(pos->accucache.psqtaccumulation);
+    pos->~chessposition();
+    freealigned64(pos);
+}
+
+// Compare the throughput of single and batched NNUE evaluation of independent positions
+void evalspeedtest(int count)
+{
+    if (!NnueReady)
+    {
+        cout << "NNUE evaluation is not enabled.\n";
+        return;
+    }
+    if (!count)
+        count = 1000000;
+
+    vector<string> fens;
+    for (const auto& game : BenchmarkPositions)
+        for (const string& fen : game)
+            fens.push_back(fen);
+
+    // one set of positions per mode so both see the same accumulator cache hits
+    chessposition* pos[2][NNUEBATCHSIZE];
+    for (int mode = 0; mode < 2; mode++)
+        for (int i = 0; i < NNUEBATCHSIZE; i++)
+            pos[mode][i] = allocNnuePosition();
+
+    int score[2][NNUEBATCHSIZE];
+    U64 evalTime[2] = { 0 };
+    int evals = 0, mismatches = 0;
+    size_t f = 0;
+    while (evals < count)
+    {
+        for (int i = 0; i < NNUEBATCHSIZE; i++, f++)
+            for (int mode = 0; mode < 2; mode++)
+            {
+                chessposition* p = pos[mode][i];
+                p->getFromFen(fens[f % fens.size()].c_str());
+                p->computationState[0][WHITE] = p->computationState[0][BLACK] = false;
+            }
+
+        U64 startTime = getTime();
+        for (int i = 0; i < NNUEBATCHSIZE; i++)
+            score[0][i] = NnueCurrentArch->GetEval(pos[0][i]);
+        U64 midTime = getTime();
+        NnueCurrentArch->GetEvalBatch(pos[1], NNUEBATCHSIZE, score[1]);
+        evalTime[0] += midTime - startTime;
+        evalTime[1] += getTime() - midTime;
+
+        for (int i = 0; i < NNUEBATCHSIZE; i++)
+            mismatches += (score[0][i] != score[1][i]);
+        evals += NNUEBATCHSIZE;
+    }
+
+    for (int mode = 0; mode < 2; mode++)
+        for (int i = 0; i < NNUEBATCHSIZE; i++)
+            freeNnuePosition(pos[mode][i]);
+
+    cout << "NNUE eval speedtest with " << NnueCurrentArch->GetArchName() << " network, " << evals << " positions in batches of " << NNUEBATCHSIZE << endl;
+    cout << "Single evals/second        : " << (long long)(evals * (double)en.frequency / max(evalTime[0], (U64)1)) << endl;
+    cout << "Batched evals/second       : " << (long long)(evals * (double)en.frequency / max(evalTime[1], (U64)1)) << endl;
+    if (mismatches)
+        cout << "Mismatches                 : " << mismatches << endl;
+}
+
+// Time the NNUE kernels separately on the speedtest positions or the positions of an epd file
+void evalbench(string epdfilename)
+{
+    if (!NnueReady)
+    {
+        cout << "NNUE evaluation is not enabled.\n";
+        return;
+    }
+
+    vector<string> fens;
+    if (epdfilename != "")
+    {
+        ifstream epdfile(epdfilename, ifstream::in);
+        if (!epdfile.is_open())
+        {
+            cout << "Cannot open file " << epdfilename << " for reading.\n";
+            return;
+        }
+        string line, fen, bm, am;
+        while (getline(epdfile, line))
+        {
+            getFenAndBmFromEpd(line, &fen, &bm, &am);
+            if (fen != "")
+                fens.push_back(fen);
+        }
+    }
+    else
+    {
+        for (const auto& game : BenchmarkPositions)
+            for (const string& fen : game)
+                fens.push_back(fen);
+    }
+
+    NnueKernelTimer timer = {};
+    timer.name[NnueKernelRefresh] = "AccumulatorRefresh";
+    timer.name[NnueKernelIncremental] = "AccumulatorIncrementalUpdate";
+    timer.name[NnueKernelTransform] = "Transform";
+
+    // every measurement includes one call of the clock; subtract its cost
+    U64 calibrationStart = timer.now();
+    U64 calibrationEnd = calibrationStart;
+    for (int i = 0; i < 1000; i++)
+        calibrationEnd = timer.now();
+    double overhead = (calibrationEnd - calibrationStart) / 1000.0;
+
+    // evaluate every position and the positions of a move sequence of up to 8 plies following it
+    const int plies = 8;
+    chessposition* pos = en.sthread[0].pos;
+    chessmovelist ml;
+    U64 moves = 0;
+    NnueCurrentArch->ResetAccumulationCache(pos);
+    for (const string& fen : fens)
+    {
+        if (pos->getFromFen(fen.c_str()) < 0)
+            continue;
+        pos->computationState[0][WHITE] = pos->computationState[0][BLACK] = false;
+        NnueCurrentArch->BenchKernels(pos, &timer);
+        for (int i = 0; i < plies; i++)
+        {
+            pos->prepareStack();
+            ml.length = pos->CreateMovelist<LEGALALL>(&ml.move[0]);
+            if (!ml.length)
+                break;
+            // the move is picked by the hash so every run replays the same sequence
+            pos->playMove<false>(ml.move[(pos->hash >> 32) % ml.length].code);
+            NnueCurrentArch->BenchKernels(pos, &timer);
+            moves++;
+        }
+    }
+
+    cout << "NNUE evalbench with " << NnueCurrentArch->GetArchName() << " network (" << NnueCurrentArch->GetArchDescription() << ")\n";
+    cout << "CPU-Features of binary: " << cinfo.PrintCpuFeatures(cinfo.binarySupports) << "\n";
+    cout << fens.size() << " positions, " << moves << " moves, layers timed over " << NnueKernelTimer::Repeat << " calls, timer overhead of "
+        << fixed << setprecision(1) << overhead << " ns subtracted\n";
+    cout << "Kernel                                    calls       ns/op\n";
+    for (int k = 0; k < NnueKernelNum; k++)
+    {
+        if (!timer.calls[k])
+            continue;
+        double nsPerOp = max(0.0, ((double)timer.ns[k] - overhead * timer.measurements[k]) / timer.calls[k]);
+        cout << left << setw(36) << timer.name[k] << right << setw(11) << timer.calls[k] << setw(12) << nsPerOp << "\n";
+    }
+    cout.unsetf(ios::fixed);
+    cout.precision(6);
+}
+
 #ifdef _WIN32
 
 static void readfromengine(HANDLE pipe, enginestate* es)
@@ -128,6 +128,7 @@ bool PGNtoFEN(int depth)
 {
     pos.tps.count = 0;
     pos.pwnhsh.setSize();
+    pos.mtrlhsh.setSize();
 
     int gamescount = 0;
     fenWritten = 0ULL;
@@ -247,7 +248,7 @@ bool PGNtoFEN(int depth)
                             // AGE mode (search and apply the pv of this search)
                             score = pos.alphabeta<NoPrune>(SCOREBLACKWINS, SCOREWHITEWINS, depth, false);
                             int s2m = pos.state & S2MMASK;
-                            uint32_t* pvt = pos.pvtable[pos.ply];
+                            uint32_t* pvt = pos.sst->pvtable[pos.ply];
                             int num = pos.applyPv(pvt);
                             if ((pos.state & S2MMASK) != s2m)
                                 score = -score;
@@ -1425,6 +1426,7 @@ void parseTune(vector<string> commandargs)
 void tuneInit()
 {
     pos.pwnhsh.setSize();
+    pos.mtrlhsh.setSize();
     pos.tps.count = 0;
     pos.resetStats();
     registerallevals(&pos);
@@ -1436,6 +1438,7 @@ void tuneCleanup()
     if (texelpts)
         free(texelpts);
     pos.pwnhsh.remove();
+    pos.mtrlhsh.remove();
 }
 
 } // namespace rubichess
@@ -18,14 +18,21 @@
 
 #include "RubiChess.h"
 
-#if defined(__linux__) && !defined(__ANDROID__)
-#include <sys/mman.h> // madvise
+#ifndef _WIN32
+#include <sys/mman.h> // mmap
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 using namespace rubichess;
 
 namespace rubichess {
 
+#ifdef STATISTICS
+thread_local ttstatistic* ttstatsThread = nullptr;
+#endif
+
 zobrist::zobrist()
 {
     raninit(&rnd, 0);
@@ -71,6 +78,19 @@ unsigned long long zobrist::getRnd()
 }
 
 
+U64 zobrist::getChecksum()
+{
+    U64 checksum = s2m;
+    for (int i = 0; i < 64 * 16; i++)
+        checksum ^= boardtable[i] + i;
+    for (int i = 0; i < 32; i++)
+        checksum ^= cstl[i] + i;
+    for (int i = 0; i < 64; i++)
+        checksum ^= ept[i] + i;
+    return checksum;
+}
+
+
 void zobrist::getAllHashes(chessposition* pos)
 {
     U64 hash = 0, pawnhash = 0, nonpawnhash[2] = {0};
@@ -102,6 +122,9 @@ void zobrist::getAllHashes(chessposition* pos)
     pos->pawnhash = pawnhash;
     pos->nonpawnhash[WHITE] = nonpawnhash[WHITE];
     pos->nonpawnhash[BLACK] = nonpawnhash[BLACK];
+    pos->materialkey = 0;
+    for (i = WPAWN; i <= BKING; i++)
+        pos->materialkey += POPCOUNT(pos->piece00[i]) * MATERIALKEYINC(i);
 }
 
 
@@ -125,21 +148,91 @@ U64 zobrist::getMaterialHash(chessposition* pos)
 
 
 
-transposition::~transposition()
+template <class C>
+transpositiontable<C>::~transpositiontable()
 {
     if (size > 0)
         my_large_free(table);
 }
 
-void transposition::setSize(int *sizeMb)
+// The old table whose entries are migrated by the threads in parallel when the tt is resized
+struct ttresizejob {
+    const void* source;
+    size_t sourcesize;
+    void* table;
+    size_t tablesize;
+    uint8_t age;
+};
+
+// Every cluster of the new table collects the entries of the old clusters with the same index bits.
+// Growing the table copies an old cluster to all new clusters it can map to (the additional index
+// bits of the stored positions are unknown), shrinking keeps the most valuable entries of the merged clusters.
+template <class C>
+static void resizeTranspositiontable(workingthread* thr)
+{
+    const ttresizejob* job = (const ttresizejob*)thr->jobArg;
+    const C* source = (const C*)job->source;
+    C* target = (C*)job->table;
+    size_t sizePerThread = job->tablesize / en.Threads;
+    size_t start = thr->index * sizePerThread;
+    size_t end = (thr->index < en.Threads - 1 ? start + sizePerThread : job->tablesize);
+
+    for (size_t i = start; i < end; i++)
+    {
+        U64 data[C::entries];
+        hashupper_t key[C::entries];
+        int value[C::entries];
+        int num = 0;
+        for (size_t src = i & (job->sourcesize - 1); src < job->sourcesize; src += job->tablesize)
+        {
+            for (int j = 0; j < C::entries; j++)
+            {
+                U64 d = source[src].data[j].load(memory_order_relaxed);
+                ttentry e = ttunpack(d);
+                if (!e.depth)
+                    continue;
+                int v = e.depth - ((AGECYCLE + job->age - e.boundAndAge) & AGEMASK) * 2;
+                int slot = num;
+                if (num == C::entries)
+                {
+                    // all slots used; replace the least valuable if the new one is better
+                    slot = 0;
+                    for (int k = 1; k < C::entries; k++)
+                        if (value[k] < value[slot])
+                            slot = k;
+                    if (value[slot] >= v)
+                        continue;
+                }
+                else
+                {
+                    num++;
+                }
+                data[slot] = d;
+                key[slot] = source[src].key[j].load(memory_order_relaxed);
+                value[slot] = v;
+            }
+        }
+#ifdef SDEBUG
+        memset((void*)&target[i], 0, sizeof(C));
+#endif
+        for (int j = 0; j < C::entries; j++)
+        {
+            target[i].data[j].store(j < num ? data[j] : 0, memory_order_relaxed);
+            target[i].key[j].store(j < num ? key[j] : 0, memory_order_relaxed);
+        }
+    }
+}
+
+template <class C>
+void transpositiontable<C>::setSize(int *sizeMb, string restorefile)
 {
     int msb = 0;
-    if (size > 0)
-        my_large_free(table);
-    size_t clustersize = sizeof(transpositioncluster);
+    C* oldtable = table;
+    size_t oldsize = size;
+    size_t clustersize = sizeof(C);
 #ifdef SDEBUG
     // Don't use the debugging part of the cluster for calculation of size to get consistent search with non SDEBUG
-    clustersize = offsetof(transpositioncluster, debugHash);
+    clustersize = offsetof(C, debugHash);
 #endif
     U64 maxsize = ((U64)*sizeMb << 20) / clustersize;
     if (!maxsize)
@@ -148,48 +241,71 @@ void transposition::setSize(int *sizeMb)
     }
     GETMSB(msb, maxsize);
     size = (1ULL << msb);
-    size_t allocsize = (size_t)(size * sizeof(transpositioncluster));
-
-#if defined(__linux__) && !defined(__ANDROID__) // Many thanks to Sami Kiminki for advise on the huge page theory and for this patch
-    // Round up hashSize to the next 2M for alignment
-    constexpr size_t HashAlignBytes = 2ull << 20;
-    allocsize = ((allocsize + HashAlignBytes - 1u) / HashAlignBytes) * HashAlignBytes;
-
-    table = (transpositioncluster*)aligned_alloc(HashAlignBytes, allocsize);
-
-    // Linux-specific call to request huge pages, in case the aligned_alloc()
-    // call above doesn't already trigger them (depends on transparent huge page
-    // settings)
-    madvise(table, allocsize, MADV_HUGEPAGE);
-#else
-    table = (transpositioncluster*)my_large_malloc(allocsize);
+    size_t allocsize = (size_t)(size * sizeof(C));
+    table = (C*)my_large_malloc(allocsize);
+    if (!table && oldsize)
+    {
+        // Not enough memory to keep the old table for migration
+        my_large_free(oldtable);
+        oldsize = 0;
+        table = (C*)my_large_malloc(allocsize);
+    }
+#ifdef USE_LIBNUMA
+    // Placement policy has to be set before the first touch in clean()
+    if (table && en.numaInterleaveHash)
+        numa_interleave(table, allocsize);
 #endif
     if (!table) {
         // alloc failed, back to old size
         size = 0;
         *sizeMb = (int)(((sizemask + 1) * clustersize) >> 20);
         cerr << "Keeping " << *sizeMb << "MByte Hash.\n";
-        setSize(sizeMb);
+        setSize(sizeMb, restorefile);
         return;
     }
 
     sizemask = size - 1;
-    clean();
+    if (oldsize)
+    {
+        ttresizejob job = { oldtable, oldsize, table, size, (uint8_t)numOfSearchShiftTwo };
+        for (int i = 0; i < en.Threads; i++)
+            en.sthread[i].run_job(resizeTranspositiontable<C>, &job);
+        for (int i = 0; i < en.Threads; i++)
+            en.sthread[i].wait_for_work_finished();
+        my_large_free(oldtable);
+    }
+    else if (restorefile == "" || !restoreFromFile(restorefile))
+    {
+        clean();
+    }
 }
 
+// The table that is cleaned (or filled from source) by the threads in parallel
+struct ttcleanjob {
+    char* table;
+    const char* source;
+    size_t bytes;
+};
+
 void cleanTranspositiontable(workingthread *thr)
 {
+    const ttcleanjob* job = (const ttcleanjob*)thr->jobArg;
     int i = thr->index;
-    size_t sizePerThread = tp.size / en.Threads;
-    void* start = (char*)(tp.table + i * sizePerThread);
-    size_t size = (i < en.Threads - 1 ? sizePerThread : tp.size - (en.Threads - 1) * sizePerThread);
-    memset(start, 0, size * sizeof(transpositioncluster));
+    size_t sizePerThread = (job->bytes / en.Threads) & ~(size_t)63;
+    size_t offset = i * sizePerThread;
+    size_t size = (i < en.Threads - 1 ? sizePerThread : job->bytes - (en.Threads - 1) * sizePerThread);
+    if (job->source)
+        memcpy(job->table + offset, job->source + offset, size);
+    else
+        memset(job->table + offset, 0, size);
 }
 
-void transposition::clean()
+template <class C>
+void transpositiontable<C>::clean()
 {
+    ttcleanjob job = { (char*)table, nullptr, size * sizeof(C) };
     for (int i = 0; i < en.Threads; i++)
-        en.sthread[i].run_job(cleanTranspositiontable);
+        en.sthread[i].run_job(cleanTranspositiontable, &job);
     for (int i = 0; i < en.Threads; i++)
         en.sthread[i].wait_for_work_finished();
 
@@ -197,21 +313,182 @@ void transposition::clean()
 }
 
 
-unsigned int transposition::getUsedinPermill()
+template <class C>
+bool transpositiontable<C>::saveToFile(string filename)
+{
+    tthashfileheader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TTFILEMAGIC, sizeof(header.magic));
+    header.zobristchecksum = zb.getChecksum();
+    header.size = size;
+    header.clusterbytes = sizeof(C);
+    header.numOfSearchShiftTwo = numOfSearchShiftTwo;
+
+    ofstream os(filename, ios::binary);
+    if (!os)
+        return false;
+    os.write((char*)&header, sizeof(header));
+    os.write((char*)table, size * sizeof(C));
+    return (bool)os;
+}
+
+
+// Restore the tt from a file written by saveToFile; the file is mapped and copied to the table by all threads
+template <class C>
+bool transpositiontable<C>::restoreFromFile(string filename)
+{
+    U64 filesize;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER fs;
+    GetFileSizeEx(file, &fs);
+    filesize = fs.QuadPart;
+    HANDLE map = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (map == NULL)
+        return false;
+    const char* data = (const char*)MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+    if (data == NULL)
+    {
+        CloseHandle(map);
+        return false;
+    }
+#else
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat statbuf;
+    fstat(fd, &statbuf);
+    filesize = statbuf.st_size;
+    int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    // read the whole file at once instead of faulting page by page while copying
+    flags |= MAP_POPULATE;
+#endif
+    const char* data = (filesize ? (const char*)mmap(NULL, filesize, PROT_READ, flags, fd, 0) : (const char*)MAP_FAILED);
+    close(fd);
+    if (data == (const char*)MAP_FAILED)
+        return false;
+#endif
+
+    const tthashfileheader* header = (const tthashfileheader*)data;
+    bool bValid = (filesize == sizeof(tthashfileheader) + size * sizeof(C)
+        && memcmp(header->magic, TTFILEMAGIC, sizeof(header->magic)) == 0
+        && header->zobristchecksum == zb.getChecksum()
+        && header->size == size
+        && header->clusterbytes == sizeof(C));
+
+    if (bValid)
+    {
+        ttcleanjob job = { (char*)table, data + sizeof(tthashfileheader), size * sizeof(C) };
+        for (int i = 0; i < en.Threads; i++)
+            en.sthread[i].run_job(cleanTranspositiontable, &job);
+        for (int i = 0; i < en.Threads; i++)
+            en.sthread[i].wait_for_work_finished();
+        numOfSearchShiftTwo = header->numOfSearchShiftTwo & AGEMASK;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+    CloseHandle(map);
+#else
+    munmap((void*)data, filesize);
+#endif
+    return bValid;
+}
+
+
+template <class C>
+unsigned int transpositiontable<C>::getUsedinPermill()
 {
     unsigned int used = 0;
 
     // Take 1000 samples
-    for (int i = 0; i < 1000 / TTBUCKETNUM; i++)
-        for (int j = 0; j < TTBUCKETNUM; j++)
-            if ((table[i].entry[j].boundAndAge & AGEMASK) == numOfSearchShiftTwo)
+    for (int i = 0; i < 1000 / C::entries; i++)
+        for (int j = 0; j < C::entries; j++)
+            if ((ttunpack(table[i].data[j].load(memory_order_relaxed)).boundAndAge & AGEMASK) == numOfSearchShiftTwo)
                 used++;
 
     return used;
 }
 
 
-void transposition::addHash(ttentry* entry, U64 hash, int val, int16_t staticeval, int bound, int depth, uint16_t movecode)
+template <class C>
+void transpositiontable<C>::printStatistics(ttstatistic* counters)
+{
+    const U64 maxsamples = 0x10000;
+    const U64 clusters = sizemask + 1;
+    const U64 samples = min(clusters, maxsamples);
+    const U64 step = clusters / samples;
+    const int agebuckets = 6;
+    const int depthbuckets = 8;
+    const char* agetext[agebuckets] = { "current", "1 ago", "2 ago", "3 ago", "4-7 ago", "8+ ago" };
+    U64 used = 0;
+    U64 ages[agebuckets] = { 0 };
+    U64 depths[depthbuckets] = { 0 };
+    U64 bounds[4] = { 0 };
+    char s[256];
+
+    if (!table)
+        return;
+
+    for (U64 i = 0; i < samples; i++)
+    {
+        C* cluster = &table[i * step];
+        for (int j = 0; j < C::entries; j++)
+        {
+            ttentry e = ttunpack(cluster->data[j].load(memory_order_relaxed));
+            if (!e.depth)
+                continue;
+            used++;
+            int searchesago = ((AGECYCLE + numOfSearchShiftTwo - e.boundAndAge) & AGEMASK) >> AGESHIFT;
+            ages[searchesago < 4 ? searchesago : searchesago < 8 ? 4 : 5]++;
+            depths[min(depthbuckets - 1, (int)FIXDEPTHFROMTT(e.depth) / 4)]++;
+            bounds[e.boundAndAge & BOUNDMASK]++;
+        }
+    }
+
+    const U64 entries = samples * C::entries;
+    snprintf(s, 256, "[TT] Size: %llu clusters of %d entries (%d bytes), %llu sampled, %.2f%% used\n",
+        clusters, C::entries, (int)sizeof(C), samples, used * 100.0 / entries);
+    guiCom << s;
+    snprintf(s, 256, "[TT] Age:  ");
+    for (int i = 0; i < agebuckets; i++)
+        snprintf(s + strlen(s), 256 - strlen(s), " %s %5.2f%%", agetext[i], used ? ages[i] * 100.0 / used : 0.0);
+    guiCom << string(s) + "\n";
+    snprintf(s, 256, "[TT] Depth:");
+    for (int i = 0; i < depthbuckets; i++)
+        snprintf(s + strlen(s), 256 - strlen(s), " %s%d %5.2f%%", i < depthbuckets - 1 ? "<" : ">=", i < depthbuckets - 1 ? (i + 1) * 4 : i * 4,
+            used ? depths[i] * 100.0 / used : 0.0);
+    guiCom << string(s) + "\n";
+    snprintf(s, 256, "[TT] Bound:  exact %5.2f%%  lower %5.2f%%  upper %5.2f%%  none (eval only) %5.2f%%\n",
+        used ? bounds[HASHEXACT] * 100.0 / used : 0.0, used ? bounds[HASHBETA] * 100.0 / used : 0.0,
+        used ? bounds[HASHALPHA] * 100.0 / used : 0.0, used ? bounds[0] * 100.0 / used : 0.0);
+    guiCom << s;
+
+    if (!counters)
+        return;
+
+    const U64 stores = counters->store_free + counters->store_update + counters->store_skipped + counters->store_replace_old + counters->store_replace_current;
+    snprintf(s, 256, "[TT] Probes: %12llu  hits: %12llu (%5.2f%%)  collisions: %10llu (%5.4f%% of hits)\n",
+        counters->probes, counters->hits, counters->probes ? counters->hits * 100.0 / counters->probes : 0.0,
+        counters->collisions, counters->hits ? counters->collisions * 100.0 / counters->hits : 0.0);
+    guiCom << s;
+    snprintf(s, 256, "[TT] Stores: %12llu  free: %5.2f%%  update: %5.2f%%  skipped: %5.2f%%  replace older: %5.2f%%  replace current: %5.2f%%\n",
+        stores,
+        stores ? counters->store_free * 100.0 / stores : 0.0,
+        stores ? counters->store_update * 100.0 / stores : 0.0,
+        stores ? counters->store_skipped * 100.0 / stores : 0.0,
+        stores ? counters->store_replace_old * 100.0 / stores : 0.0,
+        stores ? counters->store_replace_current * 100.0 / stores : 0.0);
+    guiCom << s;
+}
+
+
+template <class C>
+void transpositiontable<C>::addHash(ttslot slot, U64 hash, int val, int16_t staticeval, int bound, int depth, uint16_t movecode)
 {
 #ifdef EVALTUNE
     // don't use transposition table when tuning evaluation
@@ -219,38 +496,59 @@ void transposition::addHash(ttentry* entry, U64 hash, int val, int16_t staticeva
 #endif
     const hashupper_t hashupper = GETHASHUPPER(hash);
     const uint8_t ttdepth = depth - TTDEPTH_OFFSET;
+    const ttentry old = ttunpack(slot.data->load(memory_order_relaxed));
+    const bool samePosition = ((slot.key->load(memory_order_relaxed) ^ TTCHECKSUM(old)) == hashupper);
 
     // Don't overwrite an entry from the same position, unless we have
     // an exact bound or depth that is nearly as good as the old one
     if (bound == HASHEXACT
-        || entry->hashupper != hashupper
-        || ttdepth + 3 >= entry->depth)
+        || !samePosition
+        || ttdepth + 3 >= old.depth)
+    {
+#ifdef STATISTICS
+        if (!old.depth)
+            TTSTATISTICSINC(store_free);
+        else if (samePosition)
+            TTSTATISTICSINC(store_update);
+        else if ((old.boundAndAge & AGEMASK) != numOfSearchShiftTwo)
+            TTSTATISTICSINC(store_replace_old);
+        else
+            TTSTATISTICSINC(store_replace_current);
+#endif
+        ttentry e;
+        e.depth = (uint8_t)ttdepth;
+        e.boundAndAge = (uint8_t)(bound | numOfSearchShiftTwo);
+        e.movecode = movecode;
+        e.staticeval = staticeval;
+        e.value = (int16_t)val;
+        slot.data->store(ttpack(e), memory_order_relaxed);
+        slot.key->store(hashupper ^ TTCHECKSUM(e), memory_order_relaxed);
+    }
+    else
     {
-        entry->hashupper = hashupper;
-        entry->depth = (uint8_t)ttdepth;
-        entry->boundAndAge = (uint8_t)(bound | numOfSearchShiftTwo);
-        entry->movecode = movecode;
-        entry->staticeval = staticeval;
-        entry->value = (int16_t)val;
+        TTSTATISTICSINC(store_skipped);
     }
 }
 
 
-void transposition::printHashentry(U64 hash)
+template <class C>
+void transpositiontable<C>::printHashentry(U64 hash)
 {
     unsigned long long index = hash & sizemask;
-    transpositioncluster *data = &table[index];
+    C *data = &table[index];
     printf("Hashentry for %llx\n", hash);
-    for (int i = 0; i < TTBUCKETNUM; i++)
+    for (int i = 0; i < C::entries; i++)
     {
-        if ((data->entry[i].hashupper) == GETHASHUPPER(hash))
+        ttentry e = ttunpack(data->data[i].load(memory_order_relaxed));
+        hashupper_t hashupper = data->key[i].load(memory_order_relaxed) ^ TTCHECKSUM(e);
+        if (hashupper == GETHASHUPPER(hash))
         {
-            printf("Match in upper part: %x / %x\n", (unsigned int)data->entry[i].hashupper, (unsigned int)(hash >> 32));
-            printf("Move code: %x\n", (unsigned int)data->entry[i].movecode);
-            printf("Depth:     %d\n", data->entry[i].depth);
-            printf("Value:     %d\n", data->entry[i].value);
-            printf("Eval:      %d\n", data->entry[i].staticeval);
-            printf("BoundAge:  %d\n", data->entry[i].boundAndAge);
+            printf("Match in upper part: %x / %x\n", (unsigned int)hashupper, (unsigned int)(hash >> 32));
+            printf("Move code: %x\n", (unsigned int)e.movecode);
+            printf("Depth:     %d\n", e.depth);
+            printf("Value:     %d\n", e.value);
+            printf("Eval:      %d\n", e.staticeval);
+            printf("BoundAge:  %d\n", e.boundAndAge);
             return;
         }
     }
@@ -258,54 +556,75 @@ void transposition::printHashentry(U64 hash)
 }
 
 
-ttentry* transposition::probeHash(U64 hash, bool* bFound)
+template <class C>
+ttslot transpositiontable<C>::probeHash(U64 hash, bool* bFound, ttentry* entry)
 {
-    transpositioncluster* cluster = &table[hash & sizemask];
-    ttentry* e;
+    C* cluster = &table[hash & sizemask];
+    ttentry e[C::entries];
+    U64 d[C::entries];
     const hashupper_t hashupper = GETHASHUPPER(hash);
+    TTSTATISTICSINC(probes);
 
-    for (int i = 0; i < TTBUCKETNUM; i++)
+    for (int i = 0; i < C::entries; i++)
     {
         // First try to find a free or matching entry
-        e = &(cluster->entry[i]);
-        if (e->hashupper == hashupper || !e->depth)
+        d[i] = cluster->data[i].load(memory_order_relaxed);
+        e[i] = ttunpack(d[i]);
+        if ((cluster->key[i].load(memory_order_relaxed) ^ TTCHECKSUM(e[i])) == hashupper || !e[i].depth)
         {
-            *bFound = (bool)e->depth;
-            e->boundAndAge = (e->boundAndAge & BOUNDMASK) | numOfSearchShiftTwo;
-            return e;
+            *bFound = (bool)e[i].depth;
+            STATISTICSDO(if (*bFound) TTSTATISTICSINC(hits));
+            if ((e[i].boundAndAge & AGEMASK) != numOfSearchShiftTwo)
+            {
+                // Refresh the age; if another thread has written the slot in the meantime, just leave it alone
+                e[i].boundAndAge = (e[i].boundAndAge & BOUNDMASK) | numOfSearchShiftTwo;
+                cluster->data[i].compare_exchange_strong(d[i], ttpack(e[i]), memory_order_relaxed);
+            }
+            *entry = e[i];
+            return { &cluster->data[i], &cluster->key[i] };
         }
     }
 
     *bFound = false;
-    ttentry* leastValuableEntry = &(cluster->entry[0]);
+    int leastValuable = 0;
 
-    for (int i = 1; i < TTBUCKETNUM; i++)
+    for (int i = 1; i < C::entries; i++)
     {
-        e = &(cluster->entry[i]);
-        if (e->depth - ((AGECYCLE + numOfSearchShiftTwo - e->boundAndAge) & AGEMASK) * 2
-            < leastValuableEntry->depth - ((AGECYCLE + numOfSearchShiftTwo - leastValuableEntry->boundAndAge) & AGEMASK) * 2)
+        if (e[i].depth - ((AGECYCLE + numOfSearchShiftTwo - e[i].boundAndAge) & AGEMASK) * 2
+            < e[leastValuable].depth - ((AGECYCLE + numOfSearchShiftTwo - e[leastValuable].boundAndAge) & AGEMASK) * 2)
         {
             // found a new less valuable entry
-            leastValuableEntry = e;
+            leastValuable = i;
         }
     }
-    return leastValuableEntry;
+    *entry = e[leastValuable];
+    return { &cluster->data[leastValuable], &cluster->key[leastValuable] };
 }
 
 
-uint16_t transposition::getMoveCode(U64 hash)
+template <class C>
+uint16_t transpositiontable<C>::getMoveCode(U64 hash)
 {
     unsigned long long index = hash & sizemask;
-    transpositioncluster *data = &table[index];
-    for (int i = 0; i < TTBUCKETNUM; i++)
+    C *data = &table[index];
+    for (int i = 0; i < C::entries; i++)
     {
-        if ((data->entry[i].hashupper) == GETHASHUPPER(hash))
-            return data->entry[i].movecode;
+        ttentry e = ttunpack(data->data[i].load(memory_order_relaxed));
+        if ((data->key[i].load(memory_order_relaxed) ^ TTCHECKSUM(e)) == GETHASHUPPER(hash))
+            return e.movecode;
     }
     return 0;
 }
 
 
+// The cluster layouts that can be used by the engine or compared by the tt speedtest
+template class transpositiontable<transpositioncluster<3, 32>>;
+template class transpositiontable<transpositioncluster<6, 64>>;
+#if !((TTCLUSTERENTRIES == 3 && TTCLUSTERBYTES == 32) || (TTCLUSTERENTRIES == 6 && TTCLUSTERBYTES == 64))
+template class transpositiontable<ttcluster>;
+#endif
+
+
 void Pawnhash::setSize()
 {
     int msb = 0;
@@ -316,14 +635,15 @@ void Pawnhash::setSize()
 
     sizemask = size - 1;
     size_t tablesize = (size_t)size * sizeof(S_PAWNHASHENTRY);
-    table = (S_PAWNHASHENTRY*)allocalign64(tablesize);
+    table = (S_PAWNHASHENTRY*)my_large_malloc(tablesize);
     memset(table, 0, tablesize);
 }
 
 
 void Pawnhash::remove()
 {
-    freealigned64(table);
+    my_large_free(table);
+    table = nullptr;
 }
 
 
@@ -349,6 +669,124 @@ bool Pawnhash::probeHash(U64 hash, pawnhashentry **entry)
 }
 
 
+void Materialhash::setSize()
+{
+    size_t tablesize = MATERIALHASHSIZE * sizeof(materialhashentry);
+    table = (materialhashentry*)allocalign64(tablesize);
+    memset(table, 0, tablesize);
+}
+
+
+void Materialhash::remove()
+{
+    freealigned64(table);
+    table = nullptr;
+}
+
+
+materialhashentry* Materialhash::probeHash(chessposition *pos)
+{
+    materialhashentry* entry = &table[MATERIALHASHINDEX(pos->materialkey)];
+#ifndef EVALTUNE
+    // don't use material hash when tuning evaluation
+    if (entry->key == pos->materialkey)
+        return entry;
+#endif
+    entry->key = pos->materialkey;
+    pos->getMaterialInfo(entry);
+
+    return entry;
+}
+
+
+void SharedPawnhash::setSize(int sizeMb)
+{
+    remove();
+    int msb = 0;
+    U64 size = ((U64)sizeMb << 20) / sizeof(sharedpawnhashentry);
+    if (!size) return;
+    GETMSB(msb, size);
+    size = (1ULL << msb);
+
+    size_t tablesize = (size_t)size * sizeof(sharedpawnhashentry);
+    table = (sharedpawnhashentry*)my_large_malloc(tablesize);
+    if (!table)
+    {
+        guiCom << "info string Not enough memory for the shared pawn hash. Using private pawn hash per thread.\n";
+        return;
+    }
+    sizemask = size - 1;
+    memset((void*)table, 0, tablesize);
+}
+
+
+void SharedPawnhash::remove()
+{
+    my_large_free(table);
+    table = nullptr;
+    sizemask = 0;
+}
+
+
+bool SharedPawnhash::probeHash(U64 hash, pawnhashentry *entry)
+{
+    sharedpawnhashentry* e = &table[hash & sizemask];
+    U64 d[SHAREDPAWNHASHWORDS];
+    U64 key = e->key.load(memory_order_relaxed);
+    for (int i = 0; i < SHAREDPAWNHASHWORDS; i++)
+    {
+        d[i] = e->data[i].load(memory_order_relaxed);
+        key ^= d[i];
+    }
+#ifndef EVALTUNE
+    // don't use pawn hash when tuning evaluation
+    if (key == hash)
+    {
+        entry->hashupper = (uint32_t)(hash >> 32);
+        entry->value = (int32_t)(uint32_t)d[0];
+        entry->semiopen[0] = (unsigned char)(d[0] >> 32);
+        entry->semiopen[1] = (unsigned char)(d[0] >> 40);
+        entry->bothFlanks = (bool)(d[0] >> 48);
+        entry->passedpawnbb[0] = d[1];
+        entry->passedpawnbb[1] = d[2];
+        entry->attacked[0] = d[3];
+        entry->attacked[1] = d[4];
+        entry->attackedBy2[0] = d[5];
+        entry->attackedBy2[1] = d[6];
+        return true;
+    }
+#endif
+    entry->hashupper = (uint32_t)(hash >> 32);
+    entry->value = 0;
+    entry->semiopen[0] = entry->semiopen[1] = 0xff;
+    entry->passedpawnbb[0] = entry->passedpawnbb[1] = 0ULL;
+    entry->attacked[0] = entry->attacked[1] = 0ULL;
+    entry->attackedBy2[0] = entry->attackedBy2[1] = 0ULL;
+
+    return false;
+}
+
+
+void SharedPawnhash::addHash(U64 hash, pawnhashentry *entry)
+{
+    sharedpawnhashentry* e = &table[hash & sizemask];
+    const U64 d[SHAREDPAWNHASHWORDS] = {
+        (U64)(uint32_t)entry->value | (U64)entry->semiopen[0] << 32 | (U64)entry->semiopen[1] << 40 | (U64)entry->bothFlanks << 48,
+        entry->passedpawnbb[0], entry->passedpawnbb[1],
+        entry->attacked[0], entry->attacked[1],
+        entry->attackedBy2[0], entry->attackedBy2[1]
+    };
+    U64 key = hash;
+    for (int i = 0; i < SHAREDPAWNHASHWORDS; i++)
+    {
+        e->data[i].store(d[i], memory_order_relaxed);
+        key ^= d[i];
+    }
+    e->key.store(key, memory_order_relaxed);
+}
+
+
 transposition tp;
+SharedPawnhash sharedpwnhsh;
 
 } // namespace rubichess
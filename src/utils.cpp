@@ -550,12 +550,48 @@ void bind_thread(int index)
     pthread_setaffinity_np(handle, sizeof(cpu_set_t), &mapping[node]);
 }
 
+// Spread the pages of a fresh (untouched) allocation round robin over all nodes
+void numa_interleave(void* p, size_t size)
+{
+    if (numa_available() == -1 || numa_max_node() == 0)
+        return;
+
+    numa_interleave_memory(p, size, numa_all_nodes_ptr);
+}
+
+// Sample the pages of the tt and report their distribution over the nodes
+static string numa_hash_placement()
+{
+    const int samples = 256;
+    const int nodes = numa_max_node() + 1;
+    if (!tp.size || nodes < 2)
+        return "";
+
+    void* pages[samples];
+    int status[samples];
+    size_t step = tp.size / samples;
+    for (int i = 0; i < samples; i++)
+        pages[i] = (void*)&tp.table[i * step];
+    if (numa_move_pages(0, samples, pages, nullptr, status, 0) != 0)
+        return "";
+
+    vector<int> count(nodes, 0);
+    for (int i = 0; i < samples; i++)
+        if (status[i] >= 0 && status[i] < nodes)
+            count[status[i]]++;
+
+    string s = "  Hash " + string(en.numaInterleaveHash ? "interleaved" : "first-touch") + " (pages per node:";
+    for (int i = 0; i < nodes; i++)
+        s += " " + to_string(count[i] * 100 / samples) + "%";
+    return s + ")";
+}
+
 string numa_configuration()
 {
     if (numa_available() == -1)
         return "NUMA not available";
     
-    return to_string(numa_max_node() + 1) + " NUMA node(s)";
+    return to_string(numa_max_node() + 1) + " NUMA node(s)" + numa_hash_placement();
 }
 
 #else
@@ -565,6 +601,12 @@ void bind_thread(int index)
     (void)index;
 }
 
+void numa_interleave(void* p, size_t size)
+{
+    (void)p;
+    (void)size;
+}
+
 string numa_configuration()
 {
     return "";
@@ -597,9 +639,14 @@ U64 getTime()
 
 static int UseLargePages = -1;
 size_t largePageSize = 0;
+// Blocks allocated with VirtualAlloc; everything else comes from _aligned_malloc
+static set<void*> largePageBlocks;
+static mutex largePageMutex;
 
 void* my_large_malloc(size_t s)
 {
+    // Pawn hashes are allocated by all threads at the same time
+    lock_guard<mutex> lock(largePageMutex);
     void* mem = nullptr;
     bool allowlp = en.allowlargepages;
     
@@ -646,6 +693,10 @@ void* my_large_malloc(size_t s)
             UseLargePages = -1;
             guiCom << "info string Allocation of memory: Large pages not available for this size. Disabled for now.\n";
         }
+        else
+        {
+            largePageBlocks.insert(mem);
+        }
     }
     
     if (!mem)
@@ -663,12 +714,48 @@ void my_large_free(void* m)
     if (!m)
         return;
     
-    if (en.allowlargepages && UseLargePages > 0)
+    lock_guard<mutex> lock(largePageMutex);
+    if (largePageBlocks.erase(m))
         VirtualFree(m, 0, MEM_RELEASE);
     else
         _aligned_free(m);
 }
 
+
+// Map a file read-only; the pages are shared with other processes mapping the same file
+void* my_map_file(string filename, size_t* size)
+{
+    HANDLE hFile = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return nullptr;
+
+    LARGE_INTEGER filesize;
+    void* mem = nullptr;
+    if (GetFileSizeEx(hFile, &filesize) && filesize.QuadPart > 0)
+    {
+        HANDLE hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (hMapping)
+        {
+            mem = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(hMapping);
+        }
+    }
+    CloseHandle(hFile);
+
+    if (mem)
+        *size = (size_t)filesize.QuadPart;
+
+    return mem;
+}
+
+
+void my_unmap_file(void* m, size_t size)
+{
+    (void)size;
+    if (m)
+        UnmapViewOfFile(m);
+}
+
 #include <direct.h>
 #define MYCWD(x,y) _getcwd(x,y)
 const char kPathSeparator = '\\';
@@ -698,6 +785,136 @@ void Sleep(long x)
     nanosleep(&now, NULL);
 }
 
+#ifdef USE_LARGEPAGES
+#include <sys/mman.h>
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+
+// Blocks allocated with mmap and their sizes; everything else comes from aligned_alloc
+static map<void*, size_t> largePageBlocks;
+static mutex largePageMutex;
+static string largePageMode;
+
+static void* hugetlb_malloc(size_t* s, size_t pagesize, int flags)
+{
+    if (*s < pagesize)
+        return nullptr;
+    size_t allocsize = (*s + pagesize - 1) & ~(pagesize - 1);
+    void* mem = mmap(NULL, allocsize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | flags, -1, 0);
+    if (mem == MAP_FAILED)
+        return nullptr;
+    *s = allocsize;
+    return mem;
+}
+
+// Try explicit 1GB and 2MB pages of hugetlbfs first (these need to be reserved via vm.nr_hugepages)
+// and fall back to transparent huge pages
+void* my_large_malloc(size_t s)
+{
+    // Pawn hashes are allocated by all threads at the same time
+    lock_guard<mutex> lock(largePageMutex);
+    constexpr size_t HugePageSize = 2ull << 20;
+    constexpr size_t GigaPageSize = 1ull << 30;
+    void* mem = nullptr;
+    string mode;
+
+    if (en.allowlargepages)
+    {
+        if ((mem = hugetlb_malloc(&s, GigaPageSize, MAP_HUGE_1GB)))
+            mode = "1GB pages";
+        else if ((mem = hugetlb_malloc(&s, HugePageSize, MAP_HUGE_2MB)))
+            mode = "2MB pages";
+        if (mem)
+            largePageBlocks[mem] = s;
+    }
+
+    if (!mem && s >= HugePageSize)
+    {
+        // Many thanks to Sami Kiminki for advise on the huge page theory and for this patch
+        // Round up to the next 2M for alignment and request transparent huge pages
+        s = (s + HugePageSize - 1) & ~(HugePageSize - 1);
+        mem = aligned_alloc(HugePageSize, s);
+        if (mem)
+        {
+            madvise(mem, s, MADV_HUGEPAGE);
+            mode = "transparent huge pages";
+        }
+    }
+
+    if (!mem)
+        mem = allocalign64(s);
+
+    if (!mem)
+        cerr << "Cannot allocate memory (" << s << " bytes)\n";
+    else if (mode != "" && mode != largePageMode)
+    {
+        guiCom << "info string Allocation of memory uses " + mode + ".\n";
+        largePageMode = mode;
+    }
+
+    return mem;
+}
+
+
+void my_large_free(void* m)
+{
+    if (!m)
+        return;
+
+    lock_guard<mutex> lock(largePageMutex);
+    auto it = largePageBlocks.find(m);
+    if (it != largePageBlocks.end())
+    {
+        munmap(m, it->second);
+        largePageBlocks.erase(it);
+    }
+    else
+    {
+        free(m);
+    }
+}
+#endif
+
+#include <sys/mman.h>
+#include <fcntl.h>
+
+// Map a file read-only; the pages are shared with other processes mapping the same file
+void* my_map_file(string filename, size_t* size)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+
+    struct stat stat_buf;
+    void* mem = nullptr;
+    if (fstat(fd, &stat_buf) == 0 && stat_buf.st_size > 0)
+    {
+        mem = mmap(NULL, stat_buf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (mem == MAP_FAILED)
+            mem = nullptr;
+    }
+    close(fd);
+
+    if (mem)
+        *size = stat_buf.st_size;
+
+    return mem;
+}
+
+
+void my_unmap_file(void* m, size_t size)
+{
+    if (m)
+        munmap(m, size);
+}
+
 #define MYCWD(x,y) getcwd(x,y)
 const char kPathSeparator = '/';
 
@@ -922,6 +1139,24 @@ void statistic::output(vector<string> args)
         nnue_accupdate_cache, f0, nnue_accupdate_inc, f1, nnue_accupdate_full, f2, nnue_accupdate_spec, f3);
     guiCom << str;
 
+    // accumulator refreshes using the cache
+    n = nnue_accupdate_full;
+    U64 slotmax = 0;
+    int slotsused = 0;
+    for (int c = 0; c < 2; c++)
+        for (int s = 0; s < 64; s++)
+        {
+            slotsused += (nnue_refresh_slot[c][s] > 0);
+            slotmax = max(slotmax, nnue_refresh_slot[c][s]);
+        }
+    f0 = nnue_refresh_features / (double)NODBZ(n);
+    f1 = nnue_refresh_active / (double)NODBZ(n);
+    f2 = 100.0 * nnue_refresh_features / NODBZ(nnue_refresh_active);
+    f3 = 100.0 * slotmax / NODBZ(n);
+    snprintf(str, 512, "[STATS] AccuRefresh: Features: %10lld (%5.2f/refresh)   Scratch: %5.2f/refresh (%7.4f%% touched)   Slots used: %3d   Busiest slot: %7.4f%%\n",
+        nnue_refresh_features, f0, f1, f2, slotsused, f3);
+    guiCom << str;
+
     int p, d, l;
     // effective branching factor
     f0 = 0;